@@ -20,6 +20,27 @@ FALSE : 'false' ;
 EXTERN : 'extern' ;
 EXPORT : 'export' ;
 INCLUDE : 'include' ;
+PROBE : 'probe' ;
+BENCH : 'bench' ;
+ATOMIC : 'atomic' ;
+THREAD_LOCAL : 'thread_local' ;
+PARALLEL : 'parallel' ;
+FOR : 'for' ;
+IN : 'in' ;
+STEP : 'step' ;
+SCHEDULE : 'schedule' ;
+REDUCE : 'reduce' ;
+OVER : 'over' ;
+SPAWN : 'spawn' ;
+SYNC : 'sync' ;
+TASK : 'task' ;
+CHAN : 'chan' ;
+ASYNC : 'async' ;
+AWAIT : 'await' ;
+ARENA : 'arena' ;
+ALLOC : 'alloc' ;
+POOL : 'pool' ;
+SLICE : 'slice' ;
 
 // Type keywords
 I1 : 'i1' ;
@@ -63,23 +84,35 @@ LBRACKET : '[' ;
 RBRACKET : ']' ;
 SEMICOLON : ';' ;
 COMMA : ',' ;
+DOTDOT : '..' ;
 DOT : '.' ;
 COLON : ':' ;
 ARROW : '->' ;
 AMPERSAND : '&' ;
+HASH : '#' ;
 
 // Parser rules
 program : (include_stmt | struct_decl | function_decl | global_var_decl | extern_decl)* EOF ;
 
 include_stmt : INCLUDE STRING_LITERAL SEMICOLON ;
 
-struct_decl : STRUCT IDENTIFIER LBRACE struct_field* RBRACE ;
+struct_decl : attribute* STRUCT IDENTIFIER LBRACE struct_field* RBRACE ;
 
-struct_field : IDENTIFIER COLON type_spec SEMICOLON ;
+attribute : HASH LBRACKET IDENTIFIER (LPAREN attribute_arg (COMMA attribute_arg)* RPAREN)? RBRACKET ;
+
+attribute_arg : IDENTIFIER | INT_LITERAL ;
+
+struct_field : attribute* IDENTIFIER COLON type_spec SEMICOLON ;
 
 type_spec : basic_type
           | pointer_type
           | array_type
+          | atomic_type
+          | task_type
+          | chan_type
+          | arena_type
+          | pool_type
+          | slice_type
           | struct_type
           ;
 
@@ -89,29 +122,46 @@ pointer_type : MULTIPLY type_spec ;
 
 array_type : ARRAY LBRACKET INT_LITERAL RBRACKET type_spec ;
 
+atomic_type : ATOMIC LESS type_spec GREATER ;
+
+task_type : TASK (LESS type_spec GREATER)? ;
+
+chan_type : CHAN LESS type_spec COMMA INT_LITERAL GREATER ;
+
+arena_type : ARENA ;
+
+pool_type : POOL LESS type_spec GREATER ;
+
+slice_type : SLICE type_spec ;
+
 struct_type : IDENTIFIER ;
 
-function_decl : EXPORT? FUNCTION IDENTIFIER LPAREN param_list? RPAREN (ARROW type_spec)? LBRACE statement* RBRACE ;
+function_decl : (EXPORT | BENCH | ASYNC)? FUNCTION IDENTIFIER LPAREN param_list? RPAREN (ARROW type_spec)? LBRACE statement* RBRACE ;
 
-extern_decl : EXTERN FUNCTION IDENTIFIER LPAREN param_list? RPAREN (ARROW type_spec)? SEMICOLON ;
+extern_decl : EXTERN ASYNC? FUNCTION IDENTIFIER LPAREN param_list? RPAREN (ARROW type_spec)? SEMICOLON ;
 
 param_list : parameter (COMMA parameter)* ;
 
 parameter : IDENTIFIER COLON type_spec ;
 
-global_var_decl : LET IDENTIFIER COLON type_spec ASSIGN expression SEMICOLON ;
+global_var_decl : attribute* THREAD_LOCAL? LET IDENTIFIER COLON type_spec ASSIGN expression SEMICOLON ;
 
 statement : expr_statement
           | let_statement
           | return_statement
           | if_statement
           | while_statement
+          | for_statement
+          | probe_statement
+          | parallel_for_statement
+          | sync_statement
+          | arena_statement
           | block_statement
           ;
 
 expr_statement : expression SEMICOLON ;
 
-let_statement : LET IDENTIFIER COLON type_spec ASSIGN expression SEMICOLON ;
+let_statement : attribute* LET IDENTIFIER COLON type_spec ASSIGN expression SEMICOLON ;
 
 return_statement : RETURN expression? SEMICOLON ;
 
@@ -119,6 +169,22 @@ if_statement : IF expression LBRACE statement* RBRACE (ELSE LBRACE statement* RB
 
 while_statement : WHILE expression LBRACE statement* RBRACE ;
 
+for_statement : FOR IDENTIFIER IN expression (DOTDOT expression (STEP expression)?)? LBRACE statement* RBRACE ;
+
+parallel_for_statement : reduce_clause? PARALLEL FOR IDENTIFIER IN expression DOTDOT expression schedule_clause? LBRACE statement* RBRACE ;
+
+reduce_clause : REDUCE LPAREN reduce_op (COMMA expression)? COLON IDENTIFIER RPAREN OVER ;
+
+reduce_op : PLUS | MULTIPLY | IDENTIFIER ;
+
+schedule_clause : SCHEDULE LPAREN IDENTIFIER (COMMA expression)? RPAREN ;
+
+sync_statement : SYNC SEMICOLON ;
+
+arena_statement : ARENA IDENTIFIER LBRACE statement* RBRACE ;
+
+probe_statement : PROBE IDENTIFIER COLON IDENTIFIER LPAREN argument_list? RPAREN SEMICOLON ;
+
 block_statement : LBRACE statement* RBRACE ;
 
 expression : assignment_expr ;
@@ -138,6 +204,7 @@ additive_expr : multiplicative_expr ((PLUS | MINUS) multiplicative_expr)* ;
 multiplicative_expr : unary_expr ((MULTIPLY | DIVIDE | MODULO) unary_expr)* ;
 
 unary_expr : (NOT | MINUS | MULTIPLY | AMPERSAND) unary_expr
+           | AWAIT unary_expr
            | postfix_expr
            ;
 
@@ -150,6 +217,12 @@ primary_expr : INT_LITERAL
              | FALSE
              | IDENTIFIER
              | LPAREN expression RPAREN
+             | spawn_expr
+             | alloc_expr
              ;
 
+spawn_expr : SPAWN IDENTIFIER LPAREN argument_list? RPAREN ;
+
+alloc_expr : ALLOC LESS type_spec GREATER LPAREN expression COMMA expression RPAREN ;
+
 argument_list : expression (COMMA expression)* ;
@@ -4,6 +4,8 @@
 set -e
 
 SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+EXAMPLES_DIR="$(dirname "$SCRIPT_DIR")"
+PROJECT_DIR="$(dirname "$EXAMPLES_DIR")"
 
 mkdir -p examples/build
 
@@ -13,6 +15,24 @@ echo ""
 # Build snake
 bash "$SCRIPT_DIR/build_snake.sh"
 
+# Runtime feature examples (each prints "<name>: ok" when run); -O2 so
+# heap_to_stack shows the heap-to-stack pass
+build_example() {
+    local name="$1"
+    echo "🔧 Building $name..."
+    (cd "$PROJECT_DIR" &&
+        ./build/olc "examples/src/$name.olang" -O2 -o "examples/build/$name.o" &&
+        ./olang-link "examples/build/$name" "examples/build/$name.o" -lc)
+}
+
 echo ""
-echo "✅ All examples built successfully!"
+build_example event_loop
+build_example channels
+build_example tasks
+build_example reduce
+build_example async
+build_example heap_to_stack
+build_example loops
 
+echo ""
+echo "✅ All examples built successfully!"
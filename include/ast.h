@@ -12,6 +12,12 @@ enum class TypeKind {
     I1, I8, I16, I32, I64,
     F16, F32, F64,
     POINTER, ARRAY, STRUCT,
+    ATOMIC,  // atomic<T>: element_type is an integer or pointer type
+    TASK,    // task<T> handle from spawn: element_type is the result type (VOID for bare task)
+    CHAN,    // chan<T, N>: bounded channel of element_type, array_size is N rounded up to a power of two
+    ARENA,   // arena: bump allocator { cur, end, chunks } declared by an arena block
+    POOL,    // pool<T>: global free list of element_type objects { head, count }, one per thread
+    SLICE,   // slice T: { data, len } view of len element_type values (an array or a buffer)
     VOID
 };
 
@@ -30,6 +36,21 @@ struct Type {
     Type(TypeKind k, int size, std::shared_ptr<Type> elem) : kind(k), element_type(elem), array_size(size) {}
 };
 
+// Same source type (llvm_type is a cache and not compared)
+inline bool operator==(const Type& a, const Type& b) {
+    if (a.kind != b.kind || a.name != b.name || a.array_size != b.array_size) {
+        return false;
+    }
+    if (!a.element_type || !b.element_type) {
+        return a.element_type == b.element_type;
+    }
+    return *a.element_type == *b.element_type;
+}
+
+inline bool operator!=(const Type& a, const Type& b) {
+    return !(a == b);
+}
+
 class ASTNode {
 public:
     virtual ~ASTNode() = default;
@@ -42,10 +63,28 @@ public:
     llvm::Value* codegen(class CodeGenContext& ctx) override;
 };
 
+// #[name] or #[name(arg, ...)]
+struct Attribute {
+    std::string name;
+    std::vector<std::string> args;
+};
+
+inline const Attribute* findAttribute(const std::vector<Attribute>& attributes, const std::string& name) {
+    for (const auto& attribute : attributes) {
+        if (attribute.name == name) {
+            return &attribute;
+        }
+    }
+    return nullptr;
+}
+
 class StructDecl : public ASTNode {
 public:
     std::string name;
     std::vector<std::pair<Type, std::string>> fields;
+    std::vector<std::vector<Attribute>> field_attributes;  // Parallel to fields
+    std::vector<Attribute> attributes;
+    bool crosses_boundary = false;  // Reachable from an extern or export signature; layout is fixed
     llvm::Value* codegen(class CodeGenContext& ctx) override;
 };
 
@@ -56,6 +95,8 @@ public:
     Type return_type;
     std::vector<std::unique_ptr<ASTNode>> body;
     bool is_export = false;
+    bool is_bench = false;  // bench fn name(iters: i64), only compiled with --bench
+    bool is_async = false;  // async fn: a coroutine, started with await, block_on or detach
     llvm::Value* codegen(class CodeGenContext& ctx) override;
 };
 
@@ -64,6 +105,17 @@ public:
     std::string name;
     std::vector<std::pair<Type, std::string>> params;
     Type return_type;
+    bool is_async = false;  // Takes the awaiting coroutine first and completes it later
+    llvm::Value* codegen(class CodeGenContext& ctx) override;
+};
+
+class GlobalVarDecl : public ASTNode {
+public:
+    Type type;
+    std::string name;
+    std::unique_ptr<ASTNode> value;  // Constant initializer (ignored for arrays and structs)
+    std::vector<Attribute> attributes;
+    bool is_thread_local = false;
     llvm::Value* codegen(class CodeGenContext& ctx) override;
 };
 
@@ -72,6 +124,7 @@ public:
     Type type;
     std::string name;
     std::unique_ptr<ASTNode> value;
+    std::vector<Attribute> attributes;
     llvm::Value* codegen(class CodeGenContext& ctx) override;
 };
 
@@ -102,9 +155,62 @@ public:
     llvm::Value* codegen(class CodeGenContext& ctx) override;
 };
 
+// for var in iterable { body }: var is a copy of each element of a slice or array, in order
+// for var in start..end step s { body }: counted loop over [start, end); end is null for the iterable form
+class ForStmt : public ASTNode {
+public:
+    std::string var;
+    std::unique_ptr<ASTNode> iterable;  // Or start
+    std::unique_ptr<ASTNode> end;
+    std::unique_ptr<ASTNode> step;      // Null means 1
+    std::vector<std::unique_ptr<ASTNode>> body;
+    llvm::Value* codegen(class CodeGenContext& ctx) override;
+};
+
 // Expression nodes
 class Expr : public ASTNode {};
 
+// parallel for var in start..end schedule(kind, chunk) { body }
+class ParallelForStmt : public ASTNode {
+public:
+    enum Schedule { STATIC, DYNAMIC };  // Must match runtime/olang_parallel.c
+    enum ReduceOp { NONE, ADD, MUL, MIN, MAX, CUSTOM };
+    std::string var;
+    std::unique_ptr<ASTNode> start;
+    std::unique_ptr<ASTNode> end;
+    Schedule schedule = STATIC;
+    std::unique_ptr<ASTNode> chunk;  // Optional
+    ReduceOp reduce_op = NONE;       // reduce(op: reduce_var) over parallel for ...
+    std::string reduce_var;
+    std::string reduce_function;     // CUSTOM: fn(T, T) -> T
+    std::unique_ptr<ASTNode> reduce_identity;  // CUSTOM: the value reduce_function leaves unchanged
+    std::vector<std::unique_ptr<ASTNode>> body;
+    llvm::Value* codegen(class CodeGenContext& ctx) override;
+};
+
+// sync: wait for every task spawned by the current function
+class SyncStmt : public ASTNode {
+public:
+    llvm::Value* codegen(class CodeGenContext& ctx) override;
+};
+
+// arena name { body }: allocations from name are freed together when the block exits
+class ArenaStmt : public ASTNode {
+public:
+    std::string name;
+    std::vector<std::unique_ptr<ASTNode>> body;
+    llvm::Value* codegen(class CodeGenContext& ctx) override;
+};
+
+// USDT probe: probe provider:name(args...)
+class ProbeStmt : public ASTNode {
+public:
+    std::string provider;
+    std::string name;
+    std::vector<std::unique_ptr<Expr>> args;
+    llvm::Value* codegen(class CodeGenContext& ctx) override;
+};
+
 class IntLiteral : public Expr {
 public:
     int64_t value;
@@ -171,6 +277,13 @@ public:
     llvm::Value* codegen(class CodeGenContext& ctx) override;
 };
 
+// await f(args): run an async fn (or extern async fn) to completion, suspending meanwhile
+class AwaitExpr : public Expr {
+public:
+    std::unique_ptr<Expr> call;
+    llvm::Value* codegen(class CodeGenContext& ctx) override;
+};
+
 class CallExpr : public Expr {
 public:
     std::string function_name;
@@ -181,6 +294,23 @@ public:
     llvm::Value* codegen(class CodeGenContext& ctx) override;
 };
 
+// spawn f(args): run f(args) as a task, returns its task<T> handle
+class SpawnExpr : public Expr {
+public:
+    std::string function_name;
+    std::vector<std::unique_ptr<Expr>> args;
+    llvm::Value* codegen(class CodeGenContext& ctx) override;
+};
+
+// alloc<T>(a, n): n uninitialized Ts from arena a (an arena or *arena)
+class AllocExpr : public Expr {
+public:
+    Type type;
+    std::unique_ptr<Expr> arena;
+    std::unique_ptr<Expr> count;
+    llvm::Value* codegen(class CodeGenContext& ctx) override;
+};
+
 class MemberAccess : public Expr {
 public:
     std::unique_ptr<Expr> object;
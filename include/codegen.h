@@ -10,30 +10,140 @@
 #include <llvm/IR/GlobalVariable.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Support/raw_ostream.h>
 #include <unordered_map>
 #include <string>
 #include <memory>
+#include <functional>
 
 namespace olang {
 
+// Source-level view of a struct declaration
+struct StructInfo {
+    std::string name;
+    std::vector<std::pair<Type, std::string>> fields;  // Declaration order
+    std::vector<unsigned> field_index;                 // LLVM element index of each field
+    llvm::StructType* llvm_type = nullptr;
+    llvm::Align align;                                 // Including #[align(N)]; 1 for #[packed]
+};
+
+// A named storage location: a local alloca or a global variable
+struct Variable {
+    llvm::Value* ptr = nullptr;
+    llvm::Type* type = nullptr;  // Type stored at ptr
+    Type olang_type;
+    llvm::Align align;
+    llvm::StructType* soa_record = nullptr;  // #[soa] array: element type, stored one array per field
+    
+    explicit operator bool() const { return ptr != nullptr; }
+};
+
+// Source-level signature of a function or extern (LLVM types lose slice element types)
+struct FunctionSignature {
+    std::vector<Type> params;
+    Type result;
+};
+
+// An async fn (coroutine) or extern async fn that await can call
+struct AsyncFunction {
+    Type result;
+    llvm::StructType* promise_type = nullptr;  // { continuation, leaf_result, flags, result? }; null for extern
+};
+
+// The coroutine whose body is being generated
+struct AsyncFrame {
+    llvm::Value* id = nullptr;                 // llvm.coro.id token
+    llvm::Value* handle = nullptr;             // From llvm.coro.begin
+    llvm::AllocaInst* promise = nullptr;
+    llvm::StructType* promise_type = nullptr;
+    llvm::BasicBlock* final_block = nullptr;   // return: store the result, final suspend
+    llvm::BasicBlock* cleanup_block = nullptr; // Destroyed: free the frame
+    llvm::BasicBlock* suspend_block = nullptr; // Suspended: return to the resumer
+};
+
+// Source spelling of a type, as in declarations (src/report.cpp)
+std::string typeName(const Type& type);
+
+// Function entry/exit instrumentation (--instrument-functions)
+enum class InstrumentMode {
+    NONE,
+    COUNTS,  // Per-function call counters
+    TIMING   // Call counters plus rdtsc cycle accumulation
+};
+
 class CodeGenContext {
 private:
     llvm::LLVMContext& context;
     std::unique_ptr<llvm::Module> module;
     llvm::IRBuilder<> builder;
     
-    // Symbol table - support SSA/alloca
-    std::vector<std::unordered_map<std::string, llvm::AllocaInst*>> alloca_table;
+    // Symbol table - support SSA/alloca (globals live in the outermost scope)
+    std::vector<std::unordered_map<std::string, Variable>> variable_table;
     std::vector<std::unordered_map<std::string, llvm::Value*>> value_table;
     
     // Type table
     std::unordered_map<std::string, Type> struct_types;
     std::unordered_map<std::string, llvm::StructType*> llvm_struct_types;
+    std::unordered_map<std::string, StructInfo> struct_infos;
+    std::vector<std::string> struct_order;
+    
+    // Target machine, created by initTarget (provides the DataLayout)
+    std::unique_ptr<llvm::TargetMachine> target_machine;
+    
+    // Code emitted before every return of the current function (innermost last)
+    std::vector<std::function<void()>> cleanups;
+    
+    // Instrumentation options
+    InstrumentMode instrument_mode = InstrumentMode::NONE;
+    int xray_threshold = 0;  // 0: XRay sleds disabled
+    
+    // Benchmark mode (--bench): compile bench fns and a driver main
+    bool bench_mode = false;
+    
+    // Route malloc/calloc/realloc/free externs through runtime/olang_heap.c
+    bool heap_profile = false;
+    
+    // Reports printed after object emission
+    bool size_report = false;
+    bool layout_report = false;
+    double layout_waste_threshold = 0.25;  // Flag structs wasting more than this to padding
+    
+    // Reorder fields of every struct not crossing the extern boundary (--reorder-fields)
+    bool reorder_fields = false;
+    
+    // Runtime init functions already registered in llvm.global_ctors
+    std::vector<std::string> runtime_inits;
+    
+    // Nesting depth of outlined parallel regions being generated
+    int outlined_depth = 0;
+    
+    // Task scope (list of spawned tasks) of each function that spawns
+    std::unordered_map<llvm::Function*, llvm::Value*> task_scopes;
+    
+    // task<T> variables of each function, nulled by sync
+    std::unordered_map<llvm::Function*, std::vector<llvm::Value*>> task_handles;
+    
+    // Signatures of declared functions and externs, by name
+    std::unordered_map<std::string, FunctionSignature> function_signatures;
+    
+    // Async functions by name, and the coroutine being generated (if any)
+    std::unordered_map<std::string, AsyncFunction> async_functions;
+    AsyncFrame* async_frame = nullptr;
+    
+    // Optimization level (-O0 .. -O3); -O0 still lowers coroutines
+    int opt_level = 0;
+    
+    // Check slice indices (--bounds-check); -O1 and above drop the provably redundant checks
+    bool bounds_check = false;
+    
+    // Errors reported during codegen; main fails after codegen if any
+    int error_count = 0;
     
 public:
     CodeGenContext(llvm::LLVMContext& ctx) 
         : context(ctx), module(std::make_unique<llvm::Module>("olang", ctx)), builder(ctx) {
-        alloca_table.push_back({});
+        variable_table.push_back({});
         value_table.push_back({});
     }
     
@@ -41,32 +151,61 @@ public:
     llvm::Module* getModule() { return module.get(); }
     llvm::IRBuilder<>& getBuilder() { return builder; }
     
+    // Report a compile error: prints "Error: " and returns the stream for the message
+    llvm::raw_ostream& error() {
+        ++error_count;
+        return llvm::errs() << "Error: ";
+    }
+    int getErrorCount() const { return error_count; }
+    
     // SSA/Alloca management
     void enterScope() {
-        alloca_table.push_back({});
+        variable_table.push_back({});
         value_table.push_back({});
     }
     
     void exitScope() {
-        alloca_table.pop_back();
+        variable_table.pop_back();
         value_table.pop_back();
     }
     
-    llvm::AllocaInst* createAlloca(const std::string& name, llvm::Type* type) {
+    // Entry-block alloca aligned to at least min_align (if nonzero) and the type's #[align].
+    // With soa, an array of structs is stored as one array per field.
+    llvm::AllocaInst* createAlloca(const std::string& name, const Type& type, uint64_t min_align = 0,
+                                   bool soa = false) {
         llvm::Function* function = builder.GetInsertBlock()->getParent();
         llvm::IRBuilder<> tmp_builder(&function->getEntryBlock(), function->getEntryBlock().begin());
-        llvm::AllocaInst* alloca = tmp_builder.CreateAlloca(type, nullptr, name);
-        alloca_table.back()[name] = alloca;
+        llvm::Type* llvm_type = soa ? getSoAType(type) : getLLVMType(type);
+        llvm::AllocaInst* alloca = tmp_builder.CreateAlloca(llvm_type, nullptr, name);
+        llvm::Align align = getTypeAlign(type);
+        if (min_align > align.value()) {
+            align = llvm::Align(min_align);
+        }
+        alloca->setAlignment(align);
+        llvm::StructType* soa_record = soa ? llvm::cast<llvm::StructType>(getLLVMType(*type.element_type)) : nullptr;
+        variable_table.back()[name] = Variable{alloca, llvm_type, type, align, soa_record};
         return alloca;
     }
     
-    llvm::AllocaInst* getAlloca(const std::string& name) {
-        for (auto it = alloca_table.rbegin(); it != alloca_table.rend(); ++it) {
-            if (it->find(name) != it->end()) {
-                return (*it)[name];
+    void addGlobalVariable(const std::string& name, llvm::GlobalVariable* global, const Type& type,
+                           bool soa = false) {
+        llvm::StructType* soa_record = soa ? llvm::cast<llvm::StructType>(getLLVMType(*type.element_type)) : nullptr;
+        variable_table.front()[name] =
+            Variable{global, global->getValueType(), type, global->getAlign().valueOrOne(), soa_record};
+    }
+    
+    void setVariable(const std::string& name, const Variable& var) {
+        variable_table.back()[name] = var;
+    }
+    
+    Variable getVariable(const std::string& name) {
+        for (auto it = variable_table.rbegin(); it != variable_table.rend(); ++it) {
+            auto found = it->find(name);
+            if (found != it->end()) {
+                return found->second;
             }
         }
-        return nullptr;
+        return Variable();
     }
     
     void setValue(const std::string& name, llvm::Value* value) {
@@ -82,6 +221,70 @@ public:
         return nullptr;
     }
     
+    // Cleanup management
+    void pushCleanup(std::function<void()> cleanup) {
+        cleanups.push_back(std::move(cleanup));
+    }
+    
+    void popCleanup() {
+        cleanups.pop_back();
+    }
+    
+    size_t getCleanupDepth() const { return cleanups.size(); }
+    
+    // Drop one cleanup, keeping those pushed after it (a task scope opened inside an arena block)
+    void eraseCleanup(size_t index) {
+        cleanups.erase(cleanups.begin() + index);
+    }
+    
+    void popCleanups(size_t depth) {
+        cleanups.resize(depth);
+    }
+    
+    // Emit pending cleanups above depth (all by default) at the current insertion point
+    void emitCleanups(size_t depth = 0) {
+        for (size_t i = cleanups.size(); i > depth; --i) {
+            cleanups[i - 1]();
+        }
+    }
+    
+    // Instrumentation
+    void setInstrumentMode(InstrumentMode mode) { instrument_mode = mode; }
+    InstrumentMode getInstrumentMode() const { return instrument_mode; }
+    
+    void instrumentFunctionEntry(const std::string& name);
+    
+    // Emit XRay sleds for functions with at least `threshold` machine instructions
+    void setXRayThreshold(int threshold) { xray_threshold = threshold; }
+    int getXRayThreshold() const { return xray_threshold; }
+    
+    void setBenchMode(bool enabled) { bench_mode = enabled; }
+    bool isBenchMode() const { return bench_mode; }
+    
+    void setHeapProfile(bool enabled) { heap_profile = enabled; }
+    bool isHeapProfile() const { return heap_profile; }
+    
+    // Profiled replacement for an allocator extern (nullptr if not an allocator)
+    llvm::Function* getHeapProfileHook(llvm::Function* callee);
+    
+    // Per-function code size and stack frame report (src/report.cpp)
+    void setSizeReport(bool enabled) { size_report = enabled; }
+    void printSizeReport(llvm::StringRef object_data);
+    
+    // pahole-style struct layout report (src/report.cpp)
+    void setLayoutReport(bool enabled, double waste_threshold) {
+        layout_report = enabled;
+        layout_waste_threshold = waste_threshold;
+    }
+    bool isLayoutReport() const { return layout_report; }
+    void printLayoutReport();
+    
+    // Emit main() that runs the given bench functions through runtime/olang_bench.c
+    void emitBenchDriver(const std::vector<llvm::Function*>& benches);
+    
+    // Call a runtime init function from llvm.global_ctors (once per module)
+    void addRuntimeInit(const std::string& init_name);
+    
     // Type conversion
     llvm::Type* getLLVMType(const Type& type) {
         switch (type.kind) {
@@ -95,6 +298,29 @@ public:
             case TypeKind::F64: return llvm::Type::getDoubleTy(context);
             case TypeKind::POINTER: return llvm::PointerType::get(getLLVMType(*type.element_type), 0);
             case TypeKind::ARRAY: return llvm::ArrayType::get(getLLVMType(*type.element_type), type.array_size);
+            case TypeKind::ATOMIC: return getLLVMType(*type.element_type);
+            case TypeKind::TASK: return llvm::PointerType::get(context, 0);
+            case TypeKind::CHAN: {
+                // { tail, pad, head, pad, [N x { stamp, T }] }: must match struct chan in runtime/olang_chan.c
+                llvm::Type* i64_type = llvm::Type::getInt64Ty(context);
+                llvm::Type* pad = llvm::ArrayType::get(llvm::Type::getInt8Ty(context), 56);
+                llvm::Type* cell = llvm::StructType::get(context, {i64_type, getLLVMType(*type.element_type)});
+                return llvm::StructType::get(context, {i64_type, pad, i64_type, pad,
+                                                       llvm::ArrayType::get(cell, type.array_size)});
+            }
+            case TypeKind::ARENA: {
+                // { cur, end, chunks }: must match struct arena in runtime/olang_arena.c
+                llvm::Type* ptr_type = llvm::PointerType::get(context, 0);
+                return llvm::StructType::get(context, {ptr_type, ptr_type, ptr_type});
+            }
+            case TypeKind::POOL: {
+                // { head, count }: must match struct pool_local in runtime/olang_pool.c
+                return llvm::StructType::get(context, {llvm::PointerType::get(context, 0), llvm::Type::getInt64Ty(context)});
+            }
+            case TypeKind::SLICE: {
+                // { data, len }: the same for every element type
+                return llvm::StructType::get(context, {llvm::PointerType::get(context, 0), llvm::Type::getInt64Ty(context)});
+            }
             case TypeKind::STRUCT: {
                 if (llvm_struct_types.find(type.name) != llvm_struct_types.end()) {
                     return llvm_struct_types[type.name];
@@ -106,6 +332,16 @@ public:
         }
     }
     
+    // value where a target is expected. Olang has no implicit conversions:
+    // only a literal (integer literals default to i32, float literals to
+    // f64) takes the target type, when its value is representable. Any other
+    // mismatch is reported as an error and value is returned unchanged.
+    llvm::Value* convertValue(llvm::Value* value, llvm::Type* target);
+    
+    // An integer index, count or bound of a builtin (s[i], as_slice, alloc,
+    // for and parallel for ranges) as the i64 the IR uses
+    llvm::Value* convertIndex(llvm::Value* value);
+    
     void addStructType(const std::string& name, const Type& type, llvm::StructType* llvm_type) {
         struct_types[name] = type;
         llvm_struct_types[name] = llvm_type;
@@ -121,6 +357,96 @@ public:
         return (it != llvm_struct_types.end()) ? it->second : nullptr;
     }
     
+    void addStructInfo(const StructInfo& info) {
+        struct_infos[info.name] = info;
+        struct_order.push_back(info.name);
+    }
+    
+    const StructInfo* getStructInfo(const std::string& name) {
+        auto it = struct_infos.find(name);
+        return (it != struct_infos.end()) ? &it->second : nullptr;
+    }
+    
+    // LLVM element index of a field by source name (-1 if unknown)
+    int getMemberIndex(llvm::StructType* struct_type, const std::string& member);
+    
+    // #[soa] storage of an array of structs: a struct of per-field arrays
+    // (nullptr if type is not an array of structs)
+    llvm::StructType* getSoAType(const Type& type);
+    llvm::Value* createSoAFieldGEP(const Variable& var, llvm::Value* index, unsigned member_idx,
+                                   const std::string& name);
+    llvm::Value* loadSoAElement(const Variable& var, llvm::Value* index);
+    void storeSoAElement(const Variable& var, llvm::Value* index, llvm::Value* value);
+    
+    // Outline code into an internal void(i64 lo, i64 hi, ptr env) function. Every
+    // visible local is captured by reference through env, which is built in the
+    // current function and returned through the env argument.
+    llvm::Function* outlineRange(const std::string& name,
+                                 const std::function<void(llvm::Value* lo, llvm::Value* hi)>& emit_body,
+                                 llvm::Value*& env);
+    bool isInOutlinedRegion() const { return outlined_depth > 0; }
+    
+    // Task scope of the current function, created on first use together
+    // with the implicit sync before every return
+    llvm::Value* getTaskScope();
+    llvm::Value* findTaskScope() {
+        auto it = task_scopes.find(builder.GetInsertBlock()->getParent());
+        return it != task_scopes.end() ? it->second : nullptr;
+    }
+    
+    // sync frees the tasks of the current function: its task<T> variables
+    // are nulled so that a later join aborts instead of reading freed memory
+    void addTaskHandle(llvm::Value* ptr) {
+        task_handles[builder.GetInsertBlock()->getParent()].push_back(ptr);
+    }
+    void clearTaskHandles() {
+        for (llvm::Value* ptr : task_handles[builder.GetInsertBlock()->getParent()]) {
+            builder.CreateStore(llvm::ConstantPointerNull::get(llvm::PointerType::get(context, 0)), ptr);
+        }
+    }
+    
+    // Address of an lvalue (variable, arr[i], obj.field, *p); type receives its Olang type
+    llvm::Value* emitAddress(ASTNode* expr, Type& type);
+    
+    // Address of element index of a slice value, behind a bounds check with --bounds-check
+    llvm::Value* emitSliceElementAddress(llvm::Value* slice, llvm::Value* index, const Type& element_type);
+    
+    // Alignment of a value of this type, honoring #[align(N)] and #[packed] structs
+    llvm::Align getTypeAlign(const Type& type);
+    
+    // Alignment of element index of a struct stored at base_align (matters for #[packed])
+    llvm::Align getMemberAlign(llvm::StructType* struct_type, unsigned index, llvm::Align base_align);
+    
+    void setReorderFields(bool enabled) { reorder_fields = enabled; }
+    
+    void setOptLevel(int level) { opt_level = level; }
+    int getOptLevel() const { return opt_level; }
+    
+    void setBoundsCheck(bool enabled) { bounds_check = enabled; }
+    bool isBoundsCheck() const { return bounds_check; }
+    
+    // Run the new pass manager's default pipeline for the -O level
+    void optimize();
+    
+    void addFunctionSignature(const std::string& name, const FunctionSignature& signature) {
+        function_signatures[name] = signature;
+    }
+    const FunctionSignature* getFunctionSignature(const std::string& name) {
+        auto it = function_signatures.find(name);
+        return it != function_signatures.end() ? &it->second : nullptr;
+    }
+    
+    void addAsyncFunction(const std::string& name, const AsyncFunction& async_function) {
+        async_functions[name] = async_function;
+    }
+    const AsyncFunction* getAsyncFunction(const std::string& name) {
+        auto it = async_functions.find(name);
+        return it != async_functions.end() ? &it->second : nullptr;
+    }
+    void setAsyncFrame(AsyncFrame* frame) { async_frame = frame; }
+    AsyncFrame* getAsyncFrame() { return async_frame; }
+    bool isReorderFields() const { return reorder_fields; }
+    
     void printIR() {
         module->print(llvm::errs(), nullptr);
     }
@@ -132,6 +458,10 @@ public:
     }
     
     void setTargetTriple(const std::string& triple);
+    
+    // Create the target machine and set the module's triple and DataLayout.
+    // Called before codegen so layout decisions see the real target.
+    bool initTarget(const std::string& target_triple = "");
     bool emitObjectFile(const std::string& filename, const std::string& target_triple = "");
     
     bool verifyModule() {
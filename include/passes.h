@@ -0,0 +1,35 @@
+#pragma once
+#include <llvm/IR/PassManager.h>
+
+namespace olang {
+
+// Called by failed --bounds-check checks (runtime/olang_bounds.c)
+inline constexpr char BOUNDS_FAIL_FUNCTION[] = "__olang_bounds_fail";
+
+// Metadata on the compare-and-swap that claims a channel slot: !{!"send"} or !{!"recv"}
+inline constexpr char CHAN_CLAIM_METADATA[] = "olang.chan.claim";
+
+// Replaces malloc/calloc calls of a small constant size whose result never
+// escapes the function with an entry-block alloca, and deletes the matching
+// free calls. Runs at -O1 and above (src/passes.cpp).
+struct HeapToStackPass : llvm::PassInfoMixin<HeapToStackPass> {
+    llvm::PreservedAnalyses run(llvm::Function& function, llvm::FunctionAnalysisManager& analyses);
+};
+
+// Removes --bounds-check checks (index <u len branches to BOUNDS_FAIL_FUNCTION)
+// that scalar evolution proves always pass, typically because the enclosing
+// loop already keeps the index within the length.
+struct BoundsCheckElimPass : llvm::PassInfoMixin<BoundsCheckElimPass> {
+    llvm::PreservedAnalyses run(llvm::Function& function, llvm::FunctionAnalysisManager& analyses);
+};
+
+// Turns the compare-and-swap claims of a channel into plain stores when it
+// proves one thread sends and one thread receives: the channel is an internal
+// global whose address goes nowhere but its operations, and each side's
+// operations are only reachable, through direct calls, from main or from one
+// task spawned once, outside any loop. Runs at every level (src/passes.cpp).
+struct SpscChannelPass : llvm::PassInfoMixin<SpscChannelPass> {
+    llvm::PreservedAnalyses run(llvm::Module& module, llvm::ModuleAnalysisManager& analyses);
+};
+
+} // namespace olang
@@ -21,12 +21,20 @@ public:
     // External function declarations
     std::any visitExtern_decl(OlangParser::Extern_declContext *ctx) override;
     
+    // Global variable declarations
+    std::any visitGlobal_var_decl(OlangParser::Global_var_declContext *ctx) override;
+    
     // Statements
     std::any visitLet_statement(OlangParser::Let_statementContext *ctx) override;
     std::any visitReturn_statement(OlangParser::Return_statementContext *ctx) override;
     std::any visitExpr_statement(OlangParser::Expr_statementContext *ctx) override;
     std::any visitIf_statement(OlangParser::If_statementContext *ctx) override;
     std::any visitWhile_statement(OlangParser::While_statementContext *ctx) override;
+    std::any visitFor_statement(OlangParser::For_statementContext *ctx) override;
+    std::any visitProbe_statement(OlangParser::Probe_statementContext *ctx) override;
+    std::any visitParallel_for_statement(OlangParser::Parallel_for_statementContext *ctx) override;
+    std::any visitSync_statement(OlangParser::Sync_statementContext *ctx) override;
+    std::any visitArena_statement(OlangParser::Arena_statementContext *ctx) override;
     
     // Expressions
     std::any visitAssignment_expr(OlangParser::Assignment_exprContext *ctx) override;
@@ -43,6 +51,9 @@ public:
     // Type parsing
     Type parseType(OlangParser::Type_specContext *ctx);
     
+    // Attribute parsing
+    std::vector<Attribute> parseAttributes(const std::vector<OlangParser::AttributeContext*>& attributes);
+    
     // Helper methods
     BinaryExpr::Op getBinaryOp(antlr4::Token* token);
     UnaryExpr::Op getUnaryOp(antlr4::Token* token);
@@ -0,0 +1,118 @@
+// Olang arena runtime (arena blocks, alloc<T>)
+//
+// An arena is { cur, end, chunks }: olc inlines the bump allocation
+//
+//     if (rounded(size) <= end - cur) { p = cur; cur += rounded(size); }
+//
+// and calls __olang_arena_alloc only when the current chunk is full (or for
+// types aligned beyond ARENA_ALIGN). cur stays ARENA_ALIGN-aligned. Chunks
+// form a list headed by chunks; at block exit __olang_arena_release hands
+// standard chunks back to a per-thread cache for the next arena, so a
+// request-scoped arena in a loop stops calling malloc after the first round.
+// Requests too big for a standard chunk get a chunk of their own, which is
+// freed on release.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ARENA_ALIGN 16             // Must match ARENA_ALIGN in src/codegen.cpp
+#define CHUNK_SIZE (64 * 1024)     // Standard chunk, header included
+#define MAX_CACHED_CHUNKS 64       // Per thread: 4 MiB
+#define MAX_SIZE ((int64_t)1 << 46)
+
+struct chunk {
+    struct chunk *next;
+    size_t size;  // Bytes, header included
+};
+
+struct arena {
+    char *cur;
+    char *end;
+    struct chunk *chunks;
+};
+
+// Keeps the data ARENA_ALIGN-aligned
+#define HEADER_SIZE ((sizeof(struct chunk) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+static __thread struct chunk *cached_chunks;
+static __thread int cached_count;
+
+static inline char *chunk_data(struct chunk *chunk) {
+    return (char *)chunk + HEADER_SIZE;
+}
+
+static inline uintptr_t align_up(uintptr_t value, uintptr_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+static struct chunk *new_chunk(size_t size) {
+    struct chunk *chunk;
+    if (size == CHUNK_SIZE && cached_chunks) {
+        chunk = cached_chunks;
+        cached_chunks = chunk->next;
+        cached_count--;
+    } else {
+        chunk = aligned_alloc(ARENA_ALIGN, size);
+        if (!chunk) {
+            fprintf(stderr, "olang: alloc: out of memory (%zu bytes)\n", size);
+            abort();
+        }
+        chunk->size = size;
+    }
+    return chunk;
+}
+
+void *__olang_arena_alloc(struct arena *arena, int64_t size, int64_t align) {
+    if (size < 0 || size > MAX_SIZE) {
+        fprintf(stderr, "olang: alloc: invalid size %lld\n", (long long)size);
+        abort();
+    }
+    if (align < ARENA_ALIGN) {
+        align = ARENA_ALIGN;
+    }
+
+    // Over-aligned types come here first: the current chunk may still fit them
+    if (arena->cur) {
+        uintptr_t start = align_up((uintptr_t)arena->cur, (uintptr_t)align);
+        if (start <= (uintptr_t)arena->end && (uintptr_t)size <= (uintptr_t)arena->end - start) {
+            arena->cur = (char *)align_up(start + (uintptr_t)size, ARENA_ALIGN);
+            return (void *)start;
+        }
+    }
+
+    size_t needed = HEADER_SIZE + (size_t)size + (size_t)(align - ARENA_ALIGN);
+    if (needed > CHUNK_SIZE / 4 && arena->chunks) {
+        // Big: a chunk of its own behind the current one, which keeps its free space
+        struct chunk *chunk = new_chunk(align_up(needed, ARENA_ALIGN));
+        chunk->next = arena->chunks->next;
+        arena->chunks->next = chunk;
+        return (void *)align_up((uintptr_t)chunk_data(chunk), (uintptr_t)align);
+    }
+
+    struct chunk *chunk = new_chunk(needed <= CHUNK_SIZE ? CHUNK_SIZE : align_up(needed, ARENA_ALIGN));
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    uintptr_t start = align_up((uintptr_t)chunk_data(chunk), (uintptr_t)align);
+    arena->cur = (char *)align_up(start + (uintptr_t)size, ARENA_ALIGN);
+    arena->end = (char *)chunk + chunk->size;
+    return (void *)start;
+}
+
+void __olang_arena_release(struct arena *arena) {
+    struct chunk *chunk = arena->chunks;
+    while (chunk) {
+        struct chunk *next = chunk->next;
+        if (chunk->size == CHUNK_SIZE && cached_count < MAX_CACHED_CHUNKS) {
+            chunk->next = cached_chunks;
+            cached_chunks = chunk;
+            cached_count++;
+        } else {
+            free(chunk);
+        }
+        chunk = next;
+    }
+    arena->cur = NULL;
+    arena->end = NULL;
+    arena->chunks = NULL;
+}
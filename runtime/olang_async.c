@@ -0,0 +1,150 @@
+// Olang async runtime: single-threaded executor for async fn coroutines
+//
+// An async fn compiles to an LLVM switch-lowered coroutine. Calling it only
+// creates the frame, suspended before the body; the frame starts with the
+// resume and destroy functions, then the promise:
+//
+//     { resume(frame), destroy(frame), promise { continuation, leaf_result, flags, result } }
+//
+// resume is NULL once the coroutine has reached its final suspend point.
+//
+// `await g()` runs g inline through __olang_async_run. If g suspends, the
+// caller records itself as g's continuation and suspends too. When the
+// executor later finishes g, it queues the continuation. `await` on an
+// extern async fn passes the caller's handle to a C function, which calls
+// __olang_async_complete(handle, result) when the result is ready. That
+// stores the result and queues the handle. The ready queue is per thread:
+// each thread that calls block_on runs its own executor.
+//
+// A completion source that needs polling (the io_uring runtime in
+// olang_io.c) installs __olang_async_poller. block_on calls it without
+// waiting every POLL_INTERVAL steps, and with waiting when nothing is ready.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PROMISE_OFFSET 16  // Must match PROMISE_OFFSET in src/codegen.cpp
+#define POLL_INTERVAL 64
+
+enum { ASYNC_DETACHED = 1 };
+
+struct frame {
+    void (*resume)(struct frame *);
+    void (*destroy)(struct frame *);
+};
+
+struct promise {
+    struct frame *continuation;  // Awaiting coroutine, queued when this one finishes
+    int64_t leaf_result;         // Result of the extern async fn this coroutine awaits
+    int64_t flags;
+};
+
+struct ready_queue {
+    struct frame **slots;
+    size_t head;
+    size_t count;
+    size_t capacity;  // Power of two
+};
+
+static __thread struct ready_queue ready;
+
+// Runs pending completions (blocking for one if wait); returns how many ran
+int (*__olang_async_poller)(int wait);
+
+static inline struct promise *promise_of(struct frame *frame) {
+    return (struct promise *)((char *)frame + PROMISE_OFFSET);
+}
+
+static inline int is_done(struct frame *frame) {
+    return frame->resume == NULL;
+}
+
+static void push_ready(struct frame *frame) {
+    if (ready.count == ready.capacity) {
+        size_t capacity = ready.capacity ? ready.capacity * 2 : 64;
+        struct frame **slots = malloc(capacity * sizeof(*slots));
+        if (!slots) {
+            abort();
+        }
+        for (size_t i = 0; i < ready.count; i++) {
+            slots[i] = ready.slots[(ready.head + i) & (ready.capacity - 1)];
+        }
+        free(ready.slots);
+        ready.slots = slots;
+        ready.head = 0;
+        ready.capacity = capacity;
+    }
+    ready.slots[(ready.head + ready.count) & (ready.capacity - 1)] = frame;
+    ready.count++;
+}
+
+static struct frame *pop_ready(void) {
+    if (ready.count == 0) {
+        return NULL;
+    }
+    struct frame *frame = ready.slots[ready.head];
+    ready.head = (ready.head + 1) & (ready.capacity - 1);
+    ready.count--;
+    return frame;
+}
+
+// Resume a queued coroutine; once it finishes, wake whoever awaits it
+static void step(struct frame *frame) {
+    frame->resume(frame);
+    if (!is_done(frame)) {
+        return;
+    }
+    struct promise *promise = promise_of(frame);
+    if (promise->continuation) {
+        push_ready(promise->continuation);
+    } else if (promise->flags & ASYNC_DETACHED) {
+        frame->destroy(frame);
+    }
+}
+
+// await: start the callee; 1 if it finished inline, else 0 and the caller must suspend
+int32_t __olang_async_run(struct frame *callee, struct frame *caller) {
+    callee->resume(callee);
+    if (is_done(callee)) {
+        return 1;
+    }
+    promise_of(callee)->continuation = caller;
+    return 0;
+}
+
+void __olang_async_complete(struct frame *waiter, int64_t result) {
+    promise_of(waiter)->leaf_result = result;
+    push_ready(waiter);
+}
+
+void __olang_async_detach(struct frame *frame) {
+    promise_of(frame)->flags |= ASYNC_DETACHED;
+    push_ready(frame);
+}
+
+// Run the executor until root finishes (the caller then reads its result and destroys it)
+void __olang_async_block_on(struct frame *root) {
+    root->resume(root);
+    unsigned steps = 0;
+    while (!is_done(root)) {
+        int (*poller)(int) = __atomic_load_n(&__olang_async_poller, __ATOMIC_ACQUIRE);
+        if (poller && ++steps % POLL_INTERVAL == 0) {
+            poller(0);
+        }
+        struct frame *frame = pop_ready();
+        while (!frame && poller && poller(1) > 0) {
+            frame = pop_ready();
+        }
+        if (!frame) {
+            fprintf(stderr, "olang: block_on: no coroutine can make progress\n");
+            abort();
+        }
+        step(frame);
+    }
+}
+
+// extern async fn olang_yield(): let every other ready coroutine run first
+void olang_yield(struct frame *waiter) {
+    __olang_async_complete(waiter, 0);
+}
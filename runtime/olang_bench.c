@@ -0,0 +1,128 @@
+// Olang micro-benchmark driver (olc --bench)
+//
+// olc compiles every `bench fn name(iters: i64)` and emits a main() that
+// passes the table of bench functions to __olang_bench_main. Each benchmark
+// is calibrated (doubling the iteration count until one sample takes at
+// least OLANG_BENCH_SAMPLE_MS, default 10 ms, which doubles as warmup), then
+// timed for OLANG_BENCH_SAMPLES samples (default 50). Results are printed to
+// stdout as JSON. OLANG_BENCH_FILTER=<substring> selects benchmarks by name.
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Must match the table emitted by CodeGenContext::emitBenchDriver
+struct olang_bench {
+    const char *name;
+    void (*fn)(int64_t iters);
+};
+
+struct sample {
+    double ns_per_iter;
+    double cycles_per_iter;
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static long env_long(const char *name, long fallback) {
+    const char *value = getenv(name);
+    if (value && atol(value) > 0) {
+        return atol(value);
+    }
+    return fallback;
+}
+
+static int compare_samples(const void *a, const void *b) {
+    double da = ((const struct sample *)a)->ns_per_iter;
+    double db = ((const struct sample *)b)->ns_per_iter;
+    return (da > db) - (da < db);
+}
+
+// Nearest-rank percentile of sorted samples
+static const struct sample *percentile(const struct sample *sorted, long count, double p) {
+    long rank = (long)(p * (double)count + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return &sorted[rank - 1];
+}
+
+static void print_json_string(const char *s) {
+    putchar('"');
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            putchar('\\');
+        }
+        putchar(*s);
+    }
+    putchar('"');
+}
+
+static void run_bench(const struct olang_bench *bench, long num_samples, uint64_t target_ns, int first) {
+    // Calibrate: find an iteration count whose sample takes at least target_ns
+    int64_t iters = 1;
+    for (;;) {
+        uint64_t start = now_ns();
+        bench->fn(iters);
+        uint64_t elapsed = now_ns() - start;
+        if (elapsed >= target_ns || iters >= (INT64_MAX >> 2)) {
+            break;
+        }
+        iters *= (elapsed < target_ns / 16) ? 8 : 2;
+    }
+
+    struct sample *samples = malloc((size_t)num_samples * sizeof(*samples));
+    if (!samples) {
+        return;
+    }
+    double total_ns = 0;
+    for (long i = 0; i < num_samples; i++) {
+        uint64_t start_cycles = __builtin_ia32_rdtsc();
+        uint64_t start = now_ns();
+        bench->fn(iters);
+        uint64_t elapsed = now_ns() - start;
+        uint64_t cycles = __builtin_ia32_rdtsc() - start_cycles;
+        samples[i].ns_per_iter = (double)elapsed / (double)iters;
+        samples[i].cycles_per_iter = (double)cycles / (double)iters;
+        total_ns += samples[i].ns_per_iter;
+    }
+    qsort(samples, (size_t)num_samples, sizeof(*samples), compare_samples);
+
+    const struct sample *median = percentile(samples, num_samples, 0.5);
+    const struct sample *p99 = percentile(samples, num_samples, 0.99);
+
+    printf("%s\n    {\"name\": ", first ? "" : ",");
+    print_json_string(bench->name);
+    printf(", \"iterations\": %lld, \"samples\": %ld", (long long)iters, num_samples);
+    printf(", \"ns_per_iter\": %.3f", median->ns_per_iter);
+    printf(", \"median_ns\": %.3f, \"p99_ns\": %.3f", median->ns_per_iter, p99->ns_per_iter);
+    printf(", \"min_ns\": %.3f, \"mean_ns\": %.3f", samples[0].ns_per_iter, total_ns / (double)num_samples);
+    printf(", \"cycles_per_iter\": %.3f}", median->cycles_per_iter);
+    fflush(stdout);
+
+    free(samples);
+}
+
+int32_t __olang_bench_main(const struct olang_bench *benches, int64_t count) {
+    long num_samples = env_long("OLANG_BENCH_SAMPLES", 50);
+    uint64_t target_ns = (uint64_t)env_long("OLANG_BENCH_SAMPLE_MS", 10) * 1000000ull;
+    const char *filter = getenv("OLANG_BENCH_FILTER");
+
+    printf("{\"benchmarks\": [");
+    int first = 1;
+    for (int64_t i = 0; i < count; i++) {
+        if (filter && *filter && !strstr(benches[i].name, filter)) {
+            continue;
+        }
+        run_bench(&benches[i], num_samples, target_ns, first);
+        first = 0;
+    }
+    printf("\n]}\n");
+    return 0;
+}
@@ -0,0 +1,14 @@
+// Olang bounds check runtime (--bounds-check)
+//
+// With --bounds-check, s[i] on a slice branches here when i is not below
+// len(s). Checks that the loop around them already guarantees are removed by
+// BoundsCheckElimPass (src/passes.cpp) at -O1 and above.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+__attribute__((noreturn, cold)) void __olang_bounds_fail(int64_t index, int64_t length) {
+    fprintf(stderr, "olang: index %lld out of bounds for slice of length %lld\n", (long long)index, (long long)length);
+    abort();
+}
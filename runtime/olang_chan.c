@@ -0,0 +1,125 @@
+// Olang channel runtime (chan<T, N>)
+//
+// A chan<T, N> is a bounded lock-free ring (Vyukov's MPMC queue):
+//
+//     struct { tail; pad; head; pad; cell[N] }   cell = { stamp; T value }
+//
+// tail and head sit on their own cache lines. Each cell's stamp says whose
+// turn it is: for position pos (lap = pos & ~(N - 1)) the cell is free for a
+// sender when stamp == lap and holds a value for a receiver when
+// stamp == lap + 1; the receiver then sets it to lap + N, the next lap's free
+// stamp. Stamps are relative to the cell's index, so an all-zero channel is
+// empty and valid: globals live in .bss and `let` needs no init call.
+//
+// olc inlines one attempt of every operation and only calls these functions
+// when the cell is not ready or the claim on tail/head loses a race. Where olc
+// proves a channel has one sending and one receiving thread, the inlined path
+// claims with a plain store instead of a CAS; the CAS used here is correct
+// for those channels too. Blocking operations never make syscalls while the
+// channel is busy: they spin, then yield, then sleep with exponential backoff
+// capped at 1ms.
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#define SPIN_STEPS 64
+#define YIELD_STEPS 16
+#define MAX_SLEEP_NS 1000000
+
+struct chan {
+    _Alignas(64) _Atomic int64_t tail;  // Next position to send to
+    _Alignas(64) _Atomic int64_t head;  // Next position to receive from
+    _Alignas(64) char cells[];
+};
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static void backoff(int *step) {
+    int n = (*step)++;
+    if (n < SPIN_STEPS) {
+        cpu_relax();
+    } else if (n < SPIN_STEPS + YIELD_STEPS) {
+        sched_yield();
+    } else {
+        int shift = n - SPIN_STEPS - YIELD_STEPS;
+        long ns = shift < 10 ? 1000L << shift : MAX_SLEEP_NS;
+        struct timespec delay = {0, ns < MAX_SLEEP_NS ? ns : MAX_SLEEP_NS};
+        nanosleep(&delay, NULL);
+    }
+}
+
+static inline _Atomic int64_t *stamp_at(struct chan *chan, int64_t index, int64_t cell_size) {
+    return (_Atomic int64_t *)(chan->cells + index * cell_size);
+}
+
+int __olang_chan_try_send(struct chan *chan, const void *value, int64_t capacity, int64_t cell_size,
+                          int64_t value_offset, int64_t value_size) {
+    int64_t mask = capacity - 1;
+    int64_t pos = atomic_load_explicit(&chan->tail, memory_order_relaxed);
+    for (;;) {
+        _Atomic int64_t *stamp = stamp_at(chan, pos & mask, cell_size);
+        int64_t lap = pos & ~mask;
+        int64_t diff = atomic_load_explicit(stamp, memory_order_acquire) - lap;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&chan->tail, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                memcpy((char *)stamp + value_offset, value, (size_t)value_size);
+                atomic_store_explicit(stamp, lap + 1, memory_order_release);
+                return 1;
+            }
+        } else if (diff < 0) {
+            return 0;  // Full: the cell still holds last lap's value
+        } else {
+            pos = atomic_load_explicit(&chan->tail, memory_order_relaxed);
+        }
+    }
+}
+
+int __olang_chan_try_recv(struct chan *chan, void *value, int64_t capacity, int64_t cell_size,
+                          int64_t value_offset, int64_t value_size) {
+    int64_t mask = capacity - 1;
+    int64_t pos = atomic_load_explicit(&chan->head, memory_order_relaxed);
+    for (;;) {
+        _Atomic int64_t *stamp = stamp_at(chan, pos & mask, cell_size);
+        int64_t lap = pos & ~mask;
+        int64_t diff = atomic_load_explicit(stamp, memory_order_acquire) - (lap + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&chan->head, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                memcpy(value, (char *)stamp + value_offset, (size_t)value_size);
+                atomic_store_explicit(stamp, lap + capacity, memory_order_release);
+                return 1;
+            }
+        } else if (diff < 0) {
+            return 0;  // Empty: the cell has not been sent to this lap
+        } else {
+            pos = atomic_load_explicit(&chan->head, memory_order_relaxed);
+        }
+    }
+}
+
+void __olang_chan_send(struct chan *chan, const void *value, int64_t capacity, int64_t cell_size,
+                       int64_t value_offset, int64_t value_size) {
+    int step = 0;
+    while (!__olang_chan_try_send(chan, value, capacity, cell_size, value_offset, value_size)) {
+        backoff(&step);
+    }
+}
+
+void __olang_chan_recv(struct chan *chan, void *value, int64_t capacity, int64_t cell_size,
+                       int64_t value_offset, int64_t value_size) {
+    int step = 0;
+    while (!__olang_chan_try_recv(chan, value, capacity, cell_size, value_offset, value_size)) {
+        backoff(&step);
+    }
+}
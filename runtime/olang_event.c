@@ -0,0 +1,560 @@
+// Olang event loop runtime: epoll + timerfd
+//
+// A loop multiplexes fd readiness and timers on the thread that runs it;
+// run one loop per thread to spread thousands of sockets over a few cores.
+// Callbacks are plain function pointers (`&f` in Olang):
+//
+//     fd:    callback(ctx, fd, events)    events: OLANG_EV_* bits
+//     timer: callback(ctx)
+//     post:  callback(ctx)
+//
+// Timers live in a hierarchical timing wheel (Varghese & Lauck): LEVELS
+// wheels of 64 slots with 1ms ticks at level 0 and 64x coarser ticks per
+// level above, so adding and cancelling a timer is O(1) and a timer far in
+// the future is touched once per level on its way down. A bitmap per level
+// finds the next occupied slot without scanning, and a single timerfd in
+// the epoll set is armed for it: an idle loop sleeps in epoll_wait.
+// Timers beyond the top level's range wait in its last slot and are placed
+// again when it cascades.
+//
+// olang_loop_stop and olang_loop_post may be called from any thread; they
+// wake the loop through an eventfd. Everything else belongs to the loop's
+// thread.
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LEVELS 4
+#define SLOT_BITS 6
+#define SLOTS (1 << SLOT_BITS)
+#define MAX_EVENTS 64
+#define NO_TICK UINT64_MAX
+
+enum {
+    OLANG_EV_READABLE = 1,
+    OLANG_EV_WRITABLE = 2,
+    OLANG_EV_HANGUP = 4,
+    OLANG_EV_ERROR = 8,
+    OLANG_EV_EDGE = 16,  // Edge-triggered (register only)
+};
+
+typedef void (*fd_callback)(void *ctx, int32_t fd, int32_t events);
+typedef void (*timer_callback)(void *ctx);
+
+struct watch {
+    fd_callback callback;  // NULL: not registered
+    void *ctx;
+};
+
+// Timers are referred to by index (1-based, 0 = none) so the pool can grow
+struct timer {
+    uint64_t expiry;  // Tick
+    uint64_t interval;
+    timer_callback callback;  // NULL: free
+    void *ctx;
+    uint32_t next;
+    uint32_t prev;
+    uint32_t generation;
+    uint8_t level;
+    uint8_t slot;
+};
+
+struct post {
+    timer_callback callback;
+    void *ctx;
+    struct post *next;
+};
+
+struct loop {
+    int epoll_fd;
+    int timer_fd;
+    int wake_fd;
+    struct timespec start;  // Tick 0
+    // fd watches, indexed by fd
+    struct watch *watches;
+    int watch_capacity;
+    int watch_count;
+    // Timer wheel
+    uint64_t tick;  // Next tick to process
+    uint64_t armed;  // Tick the timerfd fires at
+    uint32_t wheel[LEVELS][SLOTS];
+    uint64_t occupied[LEVELS];
+    uint32_t expiring;  // Due timers whose callbacks are running (level LEVELS)
+    struct timer *timers;
+    uint32_t timer_capacity;
+    uint32_t free_timers;
+    uint32_t timer_count;
+    // Cross-thread
+    pthread_mutex_t post_lock;
+    struct post *posts;
+    int stopped;
+};
+
+static uint64_t now_tick(struct loop *loop) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t ns = (int64_t)(now.tv_sec - loop->start.tv_sec) * 1000000000 + (now.tv_nsec - loop->start.tv_nsec);
+    return (uint64_t)(ns / 1000000);
+}
+
+void *olang_loop_new(void) {
+    struct loop *loop = calloc(1, sizeof(struct loop));
+    if (!loop) {
+        return NULL;
+    }
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    loop->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (loop->epoll_fd < 0 || loop->timer_fd < 0 || loop->wake_fd < 0) {
+        close(loop->epoll_fd);
+        close(loop->timer_fd);
+        close(loop->wake_fd);
+        free(loop);
+        return NULL;
+    }
+    // The internal fds are told apart by data.fd = -1 / -2
+    struct epoll_event event = {.events = EPOLLIN, .data.fd = -1};
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->timer_fd, &event);
+    event.data.fd = -2;
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wake_fd, &event);
+    clock_gettime(CLOCK_MONOTONIC, &loop->start);
+    loop->armed = NO_TICK;
+    pthread_mutex_init(&loop->post_lock, NULL);
+    return loop;
+}
+
+void olang_loop_free(struct loop *loop) {
+    if (!loop) {
+        return;
+    }
+    close(loop->epoll_fd);
+    close(loop->timer_fd);
+    close(loop->wake_fd);
+    while (loop->posts) {
+        struct post *next = loop->posts->next;
+        free(loop->posts);
+        loop->posts = next;
+    }
+    pthread_mutex_destroy(&loop->post_lock);
+    free(loop->watches);
+    free(loop->timers);
+    free(loop);
+}
+
+// fd watches
+
+static uint32_t epoll_events(int32_t events) {
+    uint32_t result = 0;
+    if (events & OLANG_EV_READABLE) {
+        result |= EPOLLIN | EPOLLRDHUP;
+    }
+    if (events & OLANG_EV_WRITABLE) {
+        result |= EPOLLOUT;
+    }
+    if (events & OLANG_EV_EDGE) {
+        result |= EPOLLET;
+    }
+    return result;
+}
+
+int32_t olang_loop_add_fd(struct loop *loop, int32_t fd, int32_t events, fd_callback callback, void *ctx) {
+    if (fd < 0 || !callback) {
+        return -EINVAL;
+    }
+    if (fd >= loop->watch_capacity) {
+        int capacity = loop->watch_capacity ? loop->watch_capacity : 64;
+        while (capacity <= fd) {
+            capacity *= 2;
+        }
+        struct watch *watches = realloc(loop->watches, (size_t)capacity * sizeof(struct watch));
+        if (!watches) {
+            return -ENOMEM;
+        }
+        memset(watches + loop->watch_capacity, 0, (size_t)(capacity - loop->watch_capacity) * sizeof(struct watch));
+        loop->watches = watches;
+        loop->watch_capacity = capacity;
+    }
+    if (loop->watches[fd].callback) {
+        return -EEXIST;
+    }
+    struct epoll_event event = {.events = epoll_events(events), .data.fd = fd};
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        return -errno;
+    }
+    loop->watches[fd].callback = callback;
+    loop->watches[fd].ctx = ctx;
+    loop->watch_count++;
+    return 0;
+}
+
+int32_t olang_loop_modify_fd(struct loop *loop, int32_t fd, int32_t events) {
+    if (fd < 0 || fd >= loop->watch_capacity || !loop->watches[fd].callback) {
+        return -ENOENT;
+    }
+    struct epoll_event event = {.events = epoll_events(events), .data.fd = fd};
+    return epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, fd, &event) < 0 ? -errno : 0;
+}
+
+int32_t olang_loop_remove_fd(struct loop *loop, int32_t fd) {
+    if (fd < 0 || fd >= loop->watch_capacity || !loop->watches[fd].callback) {
+        return -ENOENT;
+    }
+    loop->watches[fd].callback = NULL;
+    loop->watch_count--;
+    // Fails harmlessly if the fd was closed first
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    return 0;
+}
+
+// Timer wheel
+
+static inline uint64_t level_shift(int level) {
+    return (uint64_t)(level * SLOT_BITS);
+}
+
+// Place a timer in the lowest level whose slot offset from the current
+// position is under 64. Above level 0 the offset is then at least 1, so the
+// slot cascades at its start tick, which is no later than the expiry.
+static void wheel_insert(struct loop *loop, uint32_t index) {
+    struct timer *timer = &loop->timers[index - 1];
+    int level = 0;
+    while (level < LEVELS - 1 &&
+           (timer->expiry >> level_shift(level)) - (loop->tick >> level_shift(level)) >= SLOTS) {
+        level++;
+    }
+    uint64_t position = timer->expiry >> level_shift(level);
+    if (position - (loop->tick >> level_shift(level)) >= SLOTS) {
+        position = (loop->tick >> level_shift(level)) + SLOTS - 1;  // Beyond the wheel
+    }
+    uint8_t slot = (uint8_t)(position & (SLOTS - 1));
+    timer->level = (uint8_t)level;
+    timer->slot = slot;
+    timer->prev = 0;
+    timer->next = loop->wheel[level][slot];
+    if (timer->next) {
+        loop->timers[timer->next - 1].prev = index;
+    }
+    loop->wheel[level][slot] = index;
+    loop->occupied[level] |= 1ull << slot;
+}
+
+static void wheel_unlink(struct loop *loop, uint32_t index) {
+    struct timer *timer = &loop->timers[index - 1];
+    if (timer->prev) {
+        loop->timers[timer->prev - 1].next = timer->next;
+    } else if (timer->level == LEVELS) {
+        loop->expiring = timer->next;
+    } else {
+        loop->wheel[timer->level][timer->slot] = timer->next;
+        if (!timer->next) {
+            loop->occupied[timer->level] &= ~(1ull << timer->slot);
+        }
+    }
+    if (timer->next) {
+        loop->timers[timer->next - 1].prev = timer->prev;
+    }
+}
+
+// Detach a whole slot, returning its list
+static uint32_t wheel_take(struct loop *loop, int level, int slot) {
+    uint32_t head = loop->wheel[level][slot];
+    loop->wheel[level][slot] = 0;
+    loop->occupied[level] &= ~(1ull << slot);
+    return head;
+}
+
+// First tick at or after loop->tick with work: an expiry at level 0, a cascade above
+static uint64_t wheel_next(struct loop *loop) {
+    uint64_t next = NO_TICK;
+    for (int level = 0; level < LEVELS; level++) {
+        uint64_t bits = loop->occupied[level];
+        if (!bits) {
+            continue;
+        }
+        // Above level 0 the current slot cascades only if we are at its start
+        uint64_t base = loop->tick >> level_shift(level);
+        unsigned from = (loop->tick & ((1ull << level_shift(level)) - 1)) == 0 ? 0 : 1;
+        unsigned rotate = (unsigned)((base + from) & (SLOTS - 1));
+        uint64_t rotated = rotate ? (bits >> rotate) | (bits << (SLOTS - rotate)) : bits;
+        uint64_t tick = (base + from + (uint64_t)__builtin_ctzll(rotated)) << level_shift(level);
+        if (tick < next) {
+            next = tick;
+        }
+    }
+    return next;
+}
+
+static uint32_t timer_alloc(struct loop *loop) {
+    if (!loop->free_timers) {
+        uint32_t capacity = loop->timer_capacity ? loop->timer_capacity * 2 : 64;
+        struct timer *timers = realloc(loop->timers, capacity * sizeof(struct timer));
+        if (!timers) {
+            return 0;
+        }
+        for (uint32_t i = loop->timer_capacity; i < capacity; i++) {
+            memset(&timers[i], 0, sizeof(struct timer));
+            timers[i].next = i + 2 <= capacity ? i + 2 : 0;
+        }
+        loop->timers = timers;
+        loop->free_timers = loop->timer_capacity + 1;
+        loop->timer_capacity = capacity;
+    }
+    uint32_t index = loop->free_timers;
+    loop->free_timers = loop->timers[index - 1].next;
+    loop->timer_count++;
+    return index;
+}
+
+static void timer_release(struct loop *loop, uint32_t index) {
+    struct timer *timer = &loop->timers[index - 1];
+    timer->callback = NULL;
+    timer->generation++;
+    timer->next = loop->free_timers;
+    loop->free_timers = index;
+    loop->timer_count--;
+}
+
+static void arm(struct loop *loop) {
+    uint64_t next = wheel_next(loop);
+    if (next == loop->armed) {
+        return;
+    }
+    loop->armed = next;
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    if (next != NO_TICK) {
+        // Absolute: start + next ms (a zero it_value would disarm)
+        uint64_t ns = (uint64_t)loop->start.tv_nsec + (next % 1000) * 1000000;
+        spec.it_value.tv_sec = loop->start.tv_sec + (time_t)(next / 1000) + (time_t)(ns / 1000000000);
+        spec.it_value.tv_nsec = (long)(ns % 1000000000);
+    }
+    timerfd_settime(loop->timer_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+// Run callback(ctx) after delay_ms, then every interval_ms if non-zero.
+// Returns a timer id for olang_loop_cancel_timer (0 if out of memory).
+int64_t olang_loop_add_timer(struct loop *loop, int64_t delay_ms, int64_t interval_ms, timer_callback callback,
+                             void *ctx) {
+    if (!callback) {
+        return 0;
+    }
+    uint32_t index = timer_alloc(loop);
+    if (!index) {
+        return 0;
+    }
+    struct timer *timer = &loop->timers[index - 1];
+    uint64_t expiry = now_tick(loop) + (uint64_t)(delay_ms > 0 ? delay_ms : 0);
+    timer->expiry = expiry > loop->tick ? expiry : loop->tick;
+    timer->interval = interval_ms > 0 ? (uint64_t)interval_ms : 0;
+    timer->callback = callback;
+    timer->ctx = ctx;
+    wheel_insert(loop, index);
+    if (timer->expiry < loop->armed) {
+        arm(loop);
+    }
+    return (int64_t)(((uint64_t)timer->generation << 32) | index);
+}
+
+// 0, or -ENOENT if the timer already fired (one-shot) or was cancelled
+int32_t olang_loop_cancel_timer(struct loop *loop, int64_t id) {
+    uint32_t index = (uint32_t)id;
+    if (index == 0 || index > loop->timer_capacity) {
+        return -ENOENT;
+    }
+    struct timer *timer = &loop->timers[index - 1];
+    if (!timer->callback || timer->generation != (uint32_t)((uint64_t)id >> 32)) {
+        return -ENOENT;
+    }
+    wheel_unlink(loop, index);
+    timer_release(loop, index);
+    return 0;
+}
+
+// Process every tick up to now; returns the number of callbacks run
+static int run_timers(struct loop *loop) {
+    int count = 0;
+    uint64_t now = now_tick(loop);
+    for (;;) {
+        uint64_t tick = wheel_next(loop);
+        if (tick > now) {
+            loop->tick = now + 1;
+            break;
+        }
+        loop->tick = tick;
+        for (int level = LEVELS - 1; level > 0; level--) {
+            if (tick & ((1ull << level_shift(level)) - 1)) {
+                continue;
+            }
+            uint32_t index = wheel_take(loop, level, (int)((tick >> level_shift(level)) & (SLOTS - 1)));
+            while (index) {
+                uint32_t next = loop->timers[index - 1].next;
+                wheel_insert(loop, index);
+                index = next;
+            }
+        }
+        // Callbacks may cancel timers still on the list, so it stays linked
+        loop->expiring = wheel_take(loop, 0, (int)(tick & (SLOTS - 1)));
+        for (uint32_t index = loop->expiring; index; index = loop->timers[index - 1].next) {
+            loop->timers[index - 1].level = LEVELS;
+        }
+        // Timers added by the callbacks below start at the next tick
+        loop->tick = tick + 1;
+        while (loop->expiring) {
+            uint32_t index = loop->expiring;
+            struct timer *timer = &loop->timers[index - 1];
+            wheel_unlink(loop, index);
+            timer_callback callback = timer->callback;
+            void *ctx = timer->ctx;
+            if (timer->interval) {
+                timer->expiry += timer->interval;
+                if (timer->expiry < loop->tick) {
+                    timer->expiry = loop->tick;  // Fell behind: skip the missed runs
+                }
+                wheel_insert(loop, index);
+            } else {
+                timer_release(loop, index);
+            }
+            callback(ctx);
+            count++;
+        }
+    }
+    return count;
+}
+
+// Cross-thread
+
+static void wake(struct loop *loop) {
+    uint64_t one = 1;
+    ssize_t written = write(loop->wake_fd, &one, sizeof(one));
+    (void)written;
+}
+
+void olang_loop_stop(struct loop *loop) {
+    __atomic_store_n(&loop->stopped, 1, __ATOMIC_RELEASE);
+    wake(loop);
+}
+
+// Run callback(ctx) on the loop's thread during its next iteration
+int32_t olang_loop_post(struct loop *loop, timer_callback callback, void *ctx) {
+    struct post *post = malloc(sizeof(struct post));
+    if (!post) {
+        return -ENOMEM;
+    }
+    post->callback = callback;
+    post->ctx = ctx;
+    pthread_mutex_lock(&loop->post_lock);
+    post->next = loop->posts;
+    loop->posts = post;
+    pthread_mutex_unlock(&loop->post_lock);
+    wake(loop);
+    return 0;
+}
+
+static int run_posts(struct loop *loop) {
+    uint64_t value;
+    ssize_t drained = read(loop->wake_fd, &value, sizeof(value));
+    (void)drained;
+    pthread_mutex_lock(&loop->post_lock);
+    struct post *post = loop->posts;
+    loop->posts = NULL;
+    pthread_mutex_unlock(&loop->post_lock);
+
+    // Posted newest first: reverse into posting order
+    struct post *ordered = NULL;
+    while (post) {
+        struct post *next = post->next;
+        post->next = ordered;
+        ordered = post;
+        post = next;
+    }
+    int count = 0;
+    while (ordered) {
+        struct post *next = ordered->next;
+        ordered->callback(ordered->ctx);
+        free(ordered);
+        ordered = next;
+        count++;
+    }
+    return count;
+}
+
+// Running
+
+// Wait up to timeout_ms (-1: until something happens) and run the callbacks
+// that are due; returns how many ran, or -errno
+int32_t olang_loop_run_once(struct loop *loop, int32_t timeout_ms) {
+    struct epoll_event events[MAX_EVENTS];
+    int ready = epoll_wait(loop->epoll_fd, events, MAX_EVENTS, timeout_ms);
+    if (ready < 0) {
+        return errno == EINTR ? 0 : -errno;
+    }
+    int count = 0;
+    int timers_due = 0;
+    for (int i = 0; i < ready; i++) {
+        int fd = events[i].data.fd;
+        if (fd == -1) {
+            uint64_t expirations;
+            ssize_t drained = read(loop->timer_fd, &expirations, sizeof(expirations));
+            (void)drained;
+            loop->armed = NO_TICK;
+            timers_due = 1;
+            continue;
+        }
+        if (fd == -2) {
+            count += run_posts(loop);
+            continue;
+        }
+        // An earlier callback in this batch may have removed the fd
+        if (fd >= loop->watch_capacity || !loop->watches[fd].callback) {
+            continue;
+        }
+        uint32_t flags = events[i].events;
+        int32_t ready_events = 0;
+        if (flags & (EPOLLIN | EPOLLPRI)) {
+            ready_events |= OLANG_EV_READABLE;
+        }
+        if (flags & EPOLLOUT) {
+            ready_events |= OLANG_EV_WRITABLE;
+        }
+        if (flags & (EPOLLHUP | EPOLLRDHUP)) {
+            ready_events |= OLANG_EV_HANGUP;
+        }
+        if (flags & EPOLLERR) {
+            ready_events |= OLANG_EV_ERROR;
+        }
+        loop->watches[fd].callback(loop->watches[fd].ctx, fd, ready_events);
+        count++;
+    }
+    if (timers_due || wheel_next(loop) <= now_tick(loop)) {
+        count += run_timers(loop);
+    }
+    arm(loop);
+    return count;
+}
+
+// Run until olang_loop_stop, or until no fd or timer is left to wait for
+int32_t olang_loop_run(struct loop *loop) {
+    __atomic_store_n(&loop->stopped, 0, __ATOMIC_RELAXED);
+    arm(loop);
+    while (!__atomic_load_n(&loop->stopped, __ATOMIC_ACQUIRE) && (loop->watch_count > 0 || loop->timer_count > 0)) {
+        int32_t result = olang_loop_run_once(loop, -1);
+        if (result < 0) {
+            return result;
+        }
+    }
+    return 0;
+}
+
+// Milliseconds since the loop was created
+int64_t olang_loop_now(struct loop *loop) {
+    return (int64_t)now_tick(loop);
+}
@@ -0,0 +1,284 @@
+// Olang heap allocation profiler (--heap-profile)
+//
+// With --heap-profile, olc rewrites calls to the malloc/calloc/realloc/free
+// externs into __olang_heap_* calls that carry the name of the calling Olang
+// function. Live allocations are tracked in a hash table keyed by address;
+// per call site we record counts, bytes, peak live bytes and lifetimes.
+// The report is written to stderr at exit ($OLANG_HEAP_PROFILE_OUT to
+// redirect), sorted by bytes allocated.
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct site_stats {
+    const char *name;
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t reallocs;
+    uint64_t bytes;
+    uint64_t live_bytes;
+    uint64_t peak_live_bytes;
+    uint64_t freed_lifetime_ns;
+};
+
+struct live_block {
+    uintptr_t address;   // 0: empty, 1: tombstone
+    uint64_t size;
+    uint64_t alloc_ns;
+    uint32_t site;
+};
+
+#define MAX_SITES 4096
+#define TOMBSTONE ((uintptr_t)1)
+
+static struct site_stats sites[MAX_SITES];
+static uint32_t num_sites;
+
+static struct live_block *blocks;
+static size_t block_capacity;
+static size_t block_used;   // live + tombstones
+
+static int lock_word;
+
+static void lock(void) {
+    while (__atomic_exchange_n(&lock_word, 1, __ATOMIC_ACQUIRE)) {
+        while (__atomic_load_n(&lock_word, __ATOMIC_RELAXED)) {
+            __builtin_ia32_pause();
+        }
+    }
+}
+
+static void unlock(void) {
+    __atomic_store_n(&lock_word, 0, __ATOMIC_RELEASE);
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static size_t hash_address(uintptr_t address) {
+    uint64_t h = (uint64_t)address * 0x9e3779b97f4a7c15ull;
+    return (size_t)(h >> 17);
+}
+
+// Site names are per-module string constants, so compare contents
+static uint32_t find_site(const char *name) {
+    for (uint32_t i = 0; i < num_sites; i++) {
+        if (sites[i].name == name || strcmp(sites[i].name, name) == 0) {
+            return i;
+        }
+    }
+    if (num_sites == MAX_SITES) {
+        return MAX_SITES - 1;
+    }
+    sites[num_sites].name = name;
+    return num_sites++;
+}
+
+static int grow_table(void) {
+    size_t old_capacity = block_capacity;
+    struct live_block *old_blocks = blocks;
+    size_t new_capacity = old_capacity ? old_capacity * 2 : 4096;
+    struct live_block *new_blocks = calloc(new_capacity, sizeof(*new_blocks));
+    if (!new_blocks) {
+        return -1;
+    }
+    blocks = new_blocks;
+    block_capacity = new_capacity;
+    block_used = 0;
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_blocks[i].address > TOMBSTONE) {
+            size_t slot = hash_address(old_blocks[i].address) & (new_capacity - 1);
+            while (blocks[slot].address != 0) {
+                slot = (slot + 1) & (new_capacity - 1);
+            }
+            blocks[slot] = old_blocks[i];
+            block_used++;
+        }
+    }
+    free(old_blocks);
+    return 0;
+}
+
+// Add a table entry; called with the lock held
+static void insert_block(const struct live_block *block) {
+    if ((block_used + 1) * 4 >= block_capacity * 3 && grow_table() != 0) {
+        return;
+    }
+    size_t slot = hash_address(block->address) & (block_capacity - 1);
+    while (blocks[slot].address > TOMBSTONE) {
+        slot = (slot + 1) & (block_capacity - 1);
+    }
+    if (blocks[slot].address == 0) {
+        block_used++;
+    }
+    blocks[slot] = *block;
+}
+
+static void record_alloc(void *p, uint64_t size, const char *site_name) {
+    if (!p) {
+        return;
+    }
+    lock();
+    uint32_t site = find_site(site_name);
+    struct site_stats *stats = &sites[site];
+    stats->allocs++;
+    stats->bytes += size;
+    stats->live_bytes += size;
+    if (stats->live_bytes > stats->peak_live_bytes) {
+        stats->peak_live_bytes = stats->live_bytes;
+    }
+    struct live_block block = {(uintptr_t)p, size, now_ns(), site};
+    insert_block(&block);
+    unlock();
+}
+
+// Remove the entry for address without accounting a free; 0 if untracked
+static int take_block(uintptr_t address, struct live_block *out) {
+    int found = 0;
+    if (!address || block_capacity == 0) {
+        return found;
+    }
+    lock();
+    size_t slot = hash_address(address) & (block_capacity - 1);
+    while (blocks[slot].address != 0) {
+        if (blocks[slot].address == address) {
+            *out = blocks[slot];
+            blocks[slot].address = TOMBSTONE;
+            found = 1;
+            break;
+        }
+        slot = (slot + 1) & (block_capacity - 1);
+    }
+    unlock();
+    return found;
+}
+
+static void account_free(const struct live_block *block) {
+    lock();
+    struct site_stats *stats = &sites[block->site];
+    stats->frees++;
+    stats->live_bytes -= block->size;
+    stats->freed_lifetime_ns += now_ns() - block->alloc_ns;
+    unlock();
+}
+
+void *__olang_heap_malloc(int64_t size, const char *site) {
+    void *p = malloc((size_t)size);
+    record_alloc(p, (uint64_t)size, site);
+    return p;
+}
+
+void *__olang_heap_calloc(int64_t count, int64_t size, const char *site) {
+    void *p = calloc((size_t)count, (size_t)size);
+    record_alloc(p, (uint64_t)count * (uint64_t)size, site);
+    return p;
+}
+
+void *__olang_heap_realloc(void *old, int64_t size, const char *site) {
+    // The entry leaves the table before realloc frees the block, so a
+    // concurrent malloc that reuses the address cannot be taken for it
+    struct live_block block;
+    int tracked = take_block((uintptr_t)old, &block);
+    void *p = realloc(old, (size_t)size);
+    if (!p && size != 0) {
+        // The old block is still valid and its accounting is unchanged
+        if (tracked) {
+            lock();
+            insert_block(&block);
+            unlock();
+        }
+        return p;
+    }
+    if (tracked) {
+        account_free(&block);
+    }
+    if (p) {
+        record_alloc(p, (uint64_t)size, site);
+        lock();
+        sites[find_site(site)].reallocs++;
+        unlock();
+    }
+    return p;
+}
+
+int32_t __olang_heap_free(void *p, const char *site) {
+    (void)site;
+    struct live_block block;
+    if (take_block((uintptr_t)p, &block)) {
+        account_free(&block);
+    }
+    free(p);
+    return 0;
+}
+
+static int compare_sites(const void *a, const void *b) {
+    const struct site_stats *sa = a;
+    const struct site_stats *sb = b;
+    return (sa->bytes < sb->bytes) - (sa->bytes > sb->bytes);
+}
+
+static void heap_profile_dump(void) {
+    lock();
+    uint32_t count = num_sites;
+    struct site_stats *sorted = malloc(sizeof(*sorted) * (count ? count : 1));
+    if (!sorted) {
+        unlock();
+        return;
+    }
+    memcpy(sorted, sites, sizeof(*sorted) * count);
+    unlock();
+
+    qsort(sorted, count, sizeof(sorted[0]), compare_sites);
+
+    FILE *out = stderr;
+    const char *path = getenv("OLANG_HEAP_PROFILE_OUT");
+    if (path && *path) {
+        FILE *file = fopen(path, "w");
+        if (file) {
+            out = file;
+        }
+    }
+
+    uint64_t total_allocs = 0, total_bytes = 0, total_live = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        total_allocs += sorted[i].allocs;
+        total_bytes += sorted[i].bytes;
+        total_live += sorted[i].live_bytes;
+    }
+
+    fprintf(out, "olang heap profile: %llu allocations, %llu bytes, %llu bytes live at exit\n",
+            (unsigned long long)total_allocs, (unsigned long long)total_bytes,
+            (unsigned long long)total_live);
+    fprintf(out, "%12s %14s %10s %12s %10s %14s %14s  %s\n", "allocs", "bytes", "avg", "peak live",
+            "leaked", "live at exit", "avg life us", "function");
+    for (uint32_t i = 0; i < count; i++) {
+        const struct site_stats *stats = &sorted[i];
+        double average = stats->allocs ? (double)stats->bytes / (double)stats->allocs : 0.0;
+        double lifetime_us = stats->frees ? (double)stats->freed_lifetime_ns / (double)stats->frees / 1e3 : 0.0;
+        fprintf(out, "%12llu %14llu %10.1f %12llu %10llu %14llu %14.1f  %s\n",
+                (unsigned long long)stats->allocs, (unsigned long long)stats->bytes, average,
+                (unsigned long long)stats->peak_live_bytes,
+                (unsigned long long)(stats->allocs - stats->frees),
+                (unsigned long long)stats->live_bytes, lifetime_us, stats->name);
+    }
+
+    if (out != stderr) {
+        fclose(out);
+    }
+    free(sorted);
+}
+
+void __olang_heap_init(void) {
+    static int registered = 0;
+    if (!registered) {
+        registered = 1;
+        atexit(heap_profile_dump);
+    }
+}
@@ -0,0 +1,79 @@
+// Olang huge page runtime (#[hugepage] globals, olang_huge_alloc)
+//
+// olc places `#[hugepage]` global arrays in the olang_hugepage section,
+// aligned to HUGE_PAGE. The loader maps .bss/.data with base pages, so a
+// constructor (__olang_hugepage_init, registered by olc) marks the section
+// range MADV_HUGEPAGE before main; with transparent huge pages in "madvise"
+// or "always" mode the kernel then backs it with 2 MiB pages on first touch
+// (or khugepaged collapses it later).
+//
+// olang_huge_alloc maps HUGE_PAGE-aligned memory: explicitly reserved huge
+// pages (MAP_HUGETLB) when the system has them, otherwise an aligned
+// anonymous mapping marked MADV_HUGEPAGE. It returns NULL when both fail.
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define HUGE_PAGE ((size_t)2 * 1024 * 1024)
+
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << 26)
+#endif
+
+// Defined by the linker when any object has an olang_hugepage section
+extern char __start_olang_hugepage[] __attribute__((weak));
+extern char __stop_olang_hugepage[] __attribute__((weak));
+
+static inline uintptr_t align_up(uintptr_t value, uintptr_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+void __olang_hugepage_init(void) {
+    uintptr_t first = (uintptr_t)__start_olang_hugepage;
+    uintptr_t last = (uintptr_t)__stop_olang_hugepage;
+    if (!first || last <= first) {
+        return;
+    }
+    // Section start is HUGE_PAGE-aligned; madvise needs a page-aligned length
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = first & ~(page - 1);
+    uintptr_t end = align_up(last, page);
+    // Failure only means THP is unavailable: the arrays still work on base pages
+    madvise((void *)start, end - start, MADV_HUGEPAGE);
+}
+
+void *olang_huge_alloc(int64_t size) {
+    if (size <= 0) {
+        return NULL;
+    }
+    size_t bytes = align_up((size_t)size, HUGE_PAGE);
+
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+    if (p != MAP_FAILED) {
+        return p;
+    }
+
+    // No reserved huge pages: over-map by one huge page and trim to alignment
+    char *raw = mmap(NULL, bytes + HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return NULL;
+    }
+    char *aligned = (char *)align_up((uintptr_t)raw, HUGE_PAGE);
+    if (aligned > raw) {
+        munmap(raw, (size_t)(aligned - raw));
+    }
+    size_t tail = (size_t)(raw + bytes + HUGE_PAGE - (aligned + bytes));
+    if (tail > 0) {
+        munmap(aligned + bytes, tail);
+    }
+    madvise(aligned, bytes, MADV_HUGEPAGE);
+    return aligned;
+}
+
+void olang_huge_free(void *p, int64_t size) {
+    if (p && size > 0) {
+        munmap(p, align_up((size_t)size, HUGE_PAGE));
+    }
+}
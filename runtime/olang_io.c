@@ -0,0 +1,348 @@
+// Olang I/O runtime: io_uring, without liburing
+//
+// Each thread gets its own ring on first use (OLANG_IO_ENTRIES submission
+// entries, default 256). Starting an operation only fills in a submission
+// queue entry; queued entries go to the kernel in one io_uring_enter when
+// the program polls, so a batch of operations costs one syscall, and
+// completions are read from the shared completion ring without any.
+//
+// Two ways to use it:
+//   - async: `await olang_io_read(fd, buf, len, off)` from an async fn. The
+//     executor (runtime/olang_async.c) polls the ring when it runs out of
+//     ready coroutines, and every POLL_INTERVAL steps otherwise.
+//   - callbacks: olang_io_read_cb(..., callback, ctx) queues the operation
+//     and olang_io_poll(wait) submits it and runs callback(ctx, result) for
+//     each completion. Errors come back as -errno in result.
+//
+// olang_io_register_buffer pins a buffer with the kernel once. Its
+// _fixed operations then skip the per-operation page mapping.
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define DEFAULT_ENTRIES 256
+#define MAX_BUFFERS 64
+
+typedef void (*io_callback)(void *ctx, int64_t result);
+
+// Executor hook (runtime/olang_async.c) and coroutine completion
+extern int (*__olang_async_poller)(int wait);
+void __olang_async_complete(void *waiter, int64_t result);
+
+struct request {
+    io_callback callback;  // NULL: ctx is an awaiting coroutine
+    void *ctx;
+    struct request *next_free;
+};
+
+struct ring {
+    int fd;
+    // Submission ring: entries queued locally up to sq_local_tail, published on poll
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned sq_local_tail;
+    unsigned sq_submitted;
+    struct io_uring_sqe *sqes;
+    // Completion ring
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+    // One request per operation in flight (at most the completion ring's size)
+    struct request *requests;
+    struct request *free_requests;
+    unsigned in_flight;
+    // Registered buffers
+    struct iovec buffers[MAX_BUFFERS];
+    int buffer_count;
+};
+
+static __thread struct ring *thread_ring;
+static __thread int ring_failed;
+
+int olang_io_poll(int wait);
+
+static struct ring *get_ring(void) {
+    if (thread_ring || ring_failed) {
+        return thread_ring;
+    }
+    ring_failed = 1;
+
+    unsigned entries = DEFAULT_ENTRIES;
+    const char *env = getenv("OLANG_IO_ENTRIES");
+    if (env && atoi(env) > 0) {
+        entries = (unsigned)atoi(env);
+    }
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    int single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        sq_size = cq_size = sq_size > cq_size ? sq_size : cq_size;
+    }
+    char *sq = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    char *cq = single_mmap ? sq
+                           : mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                                  IORING_OFF_CQ_RING);
+    struct io_uring_sqe *sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                                     MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    struct ring *ring = calloc(1, sizeof(struct ring));
+    struct request *requests = calloc(params.cq_entries, sizeof(struct request));
+    if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED || !ring || !requests) {
+        close(fd);
+        free(ring);
+        free(requests);
+        return NULL;
+    }
+
+    ring->fd = fd;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = *(unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_entries = params.sq_entries;
+    ring->sq_local_tail = ring->sq_submitted = *ring->sq_tail;
+    ring->sqes = sqes;
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = *(unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    // Submission slot i always holds entry i
+    unsigned *sq_array = (unsigned *)(sq + params.sq_off.array);
+    for (unsigned i = 0; i < params.sq_entries; i++) {
+        sq_array[i] = i;
+    }
+    for (unsigned i = 0; i < params.cq_entries; i++) {
+        requests[i].next_free = i + 1 < params.cq_entries ? &requests[i + 1] : NULL;
+    }
+    ring->requests = ring->free_requests = requests;
+
+    thread_ring = ring;
+    ring_failed = 0;
+    __atomic_store_n(&__olang_async_poller, olang_io_poll, __ATOMIC_RELEASE);
+    return ring;
+}
+
+// Run the handlers of all available completions (no syscall)
+static int reap(struct ring *ring) {
+    int count = 0;
+    unsigned head = *ring->cq_head;
+    while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+        struct request *request = (struct request *)(uintptr_t)cqe->user_data;
+        int64_t result = cqe->res;
+        head++;
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+        // Recycle the request first: the handler may start another operation
+        io_callback callback = request->callback;
+        void *ctx = request->ctx;
+        request->next_free = ring->free_requests;
+        ring->free_requests = request;
+        ring->in_flight--;
+        if (callback) {
+            callback(ctx, result);
+        } else {
+            __olang_async_complete(ctx, result);
+        }
+        count++;
+    }
+    return count;
+}
+
+static int enter(struct ring *ring, unsigned min_complete) {
+    unsigned to_submit = ring->sq_local_tail - ring->sq_submitted;
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+    int submitted = (int)syscall(__NR_io_uring_enter, ring->fd, to_submit, min_complete, flags, NULL, 0);
+    if (submitted < 0) {
+        return -errno;
+    }
+    ring->sq_submitted += (unsigned)submitted;
+    return 0;
+}
+
+// Submit queued operations and run completion handlers; with wait, block
+// until at least one completes if none has. Returns the number completed.
+int olang_io_poll(int wait) {
+    struct ring *ring = thread_ring;
+    if (!ring) {
+        return 0;
+    }
+    int count = reap(ring);
+    int pending = ring->sq_local_tail != ring->sq_submitted;
+    // Waiting with nothing in flight would block forever
+    int block = wait && count == 0 && ring->in_flight > 0;
+    if (pending || block) {
+        int error = enter(ring, block ? 1 : 0);
+        if (error < 0 && error != -EINTR && error != -EAGAIN && error != -EBUSY) {
+            return count;
+        }
+        count += reap(ring);
+    }
+    return count;
+}
+
+// Queue one operation; 0 or -errno
+static int queue(uint8_t opcode, int fd, const void *addr, uint32_t len, uint64_t offset, int buf_index,
+                 uint32_t op_flags, io_callback callback, void *ctx) {
+    struct ring *ring = get_ring();
+    if (!ring) {
+        return -ENOSYS;
+    }
+    // Every request slot busy: wait for completions to free some
+    while (!ring->free_requests) {
+        olang_io_poll(1);
+    }
+    // Submission ring full: hand the queued entries to the kernel
+    if (ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+        int error = enter(ring, 0);
+        if (error < 0 || ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+            return error < 0 ? error : -EBUSY;
+        }
+    }
+
+    struct request *request = ring->free_requests;
+    ring->free_requests = request->next_free;
+    ring->in_flight++;
+    request->callback = callback;
+    request->ctx = ctx;
+
+    struct io_uring_sqe *sqe = &ring->sqes[ring->sq_local_tail & ring->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)addr;
+    sqe->len = len;
+    sqe->off = offset;
+    sqe->buf_index = (uint16_t)buf_index;
+    sqe->rw_flags = op_flags;
+    sqe->user_data = (uint64_t)(uintptr_t)request;
+    ring->sq_local_tail++;
+    return 0;
+}
+
+// Buffer index for a registered buffer containing [buf, buf + len), or -1
+static int find_buffer(struct ring *ring, const void *buf, int64_t len) {
+    for (int i = 0; ring && i < ring->buffer_count; i++) {
+        const char *base = ring->buffers[i].iov_base;
+        if ((const char *)buf >= base && (const char *)buf + len <= base + ring->buffers[i].iov_len) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Pin buf with the kernel for the _fixed operations; returns its index or -errno
+int32_t olang_io_register_buffer(void *buf, int64_t len) {
+    struct ring *ring = get_ring();
+    if (!ring) {
+        return -ENOSYS;
+    }
+    if (ring->buffer_count == MAX_BUFFERS) {
+        return -ENOSPC;
+    }
+    // The table is registered as a whole, so replace the previous registration
+    if (ring->buffer_count > 0) {
+        syscall(__NR_io_uring_register, ring->fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+    }
+    ring->buffers[ring->buffer_count].iov_base = buf;
+    ring->buffers[ring->buffer_count].iov_len = (size_t)len;
+    if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, ring->buffers,
+                ring->buffer_count + 1) < 0) {
+        int error = -errno;
+        if (ring->buffer_count > 0) {
+            syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, ring->buffers, ring->buffer_count);
+        }
+        return error;
+    }
+    return ring->buffer_count++;
+}
+
+static int queue_fixed(uint8_t opcode, int fd, void *buf, int64_t len, int64_t offset, io_callback callback,
+                       void *ctx) {
+    int index = find_buffer(get_ring(), buf, len);
+    if (index < 0) {
+        return -EFAULT;
+    }
+    return queue(opcode, fd, buf, (uint32_t)len, (uint64_t)offset, index, 0, callback, ctx);
+}
+
+// Callback API: queue the operation; callback(ctx, result) runs from olang_io_poll
+
+int32_t olang_io_read_cb(int32_t fd, void *buf, int64_t len, int64_t offset, io_callback callback, void *ctx) {
+    return queue(IORING_OP_READ, fd, buf, (uint32_t)len, (uint64_t)offset, 0, 0, callback, ctx);
+}
+
+int32_t olang_io_write_cb(int32_t fd, const void *buf, int64_t len, int64_t offset, io_callback callback,
+                          void *ctx) {
+    return queue(IORING_OP_WRITE, fd, buf, (uint32_t)len, (uint64_t)offset, 0, 0, callback, ctx);
+}
+
+int32_t olang_io_read_fixed_cb(int32_t fd, void *buf, int64_t len, int64_t offset, io_callback callback,
+                               void *ctx) {
+    return queue_fixed(IORING_OP_READ_FIXED, fd, buf, len, offset, callback, ctx);
+}
+
+int32_t olang_io_write_fixed_cb(int32_t fd, void *buf, int64_t len, int64_t offset, io_callback callback,
+                                void *ctx) {
+    return queue_fixed(IORING_OP_WRITE_FIXED, fd, buf, len, offset, callback, ctx);
+}
+
+int32_t olang_io_accept_cb(int32_t fd, io_callback callback, void *ctx) {
+    return queue(IORING_OP_ACCEPT, fd, NULL, 0, 0, 0, 0, callback, ctx);
+}
+
+int32_t olang_io_recv_cb(int32_t fd, void *buf, int64_t len, io_callback callback, void *ctx) {
+    return queue(IORING_OP_RECV, fd, buf, (uint32_t)len, 0, 0, 0, callback, ctx);
+}
+
+// Async API (extern async fn): the waiter resumes with the result
+
+#define COMPLETE_ON_ERROR(call)                     \
+    do {                                            \
+        int error_ = (call);                        \
+        if (error_ < 0) {                           \
+            __olang_async_complete(waiter, error_); \
+        }                                           \
+    } while (0)
+
+void olang_io_read(void *waiter, int32_t fd, void *buf, int64_t len, int64_t offset) {
+    COMPLETE_ON_ERROR(queue(IORING_OP_READ, fd, buf, (uint32_t)len, (uint64_t)offset, 0, 0, NULL, waiter));
+}
+
+void olang_io_write(void *waiter, int32_t fd, const void *buf, int64_t len, int64_t offset) {
+    COMPLETE_ON_ERROR(queue(IORING_OP_WRITE, fd, buf, (uint32_t)len, (uint64_t)offset, 0, 0, NULL, waiter));
+}
+
+void olang_io_read_fixed(void *waiter, int32_t fd, void *buf, int64_t len, int64_t offset) {
+    COMPLETE_ON_ERROR(queue_fixed(IORING_OP_READ_FIXED, fd, buf, len, offset, NULL, waiter));
+}
+
+void olang_io_write_fixed(void *waiter, int32_t fd, void *buf, int64_t len, int64_t offset) {
+    COMPLETE_ON_ERROR(queue_fixed(IORING_OP_WRITE_FIXED, fd, buf, len, offset, NULL, waiter));
+}
+
+void olang_io_accept(void *waiter, int32_t fd) {
+    COMPLETE_ON_ERROR(queue(IORING_OP_ACCEPT, fd, NULL, 0, 0, 0, 0, NULL, waiter));
+}
+
+void olang_io_recv(void *waiter, int32_t fd, void *buf, int64_t len) {
+    COMPLETE_ON_ERROR(queue(IORING_OP_RECV, fd, buf, (uint32_t)len, 0, 0, 0, NULL, waiter));
+}
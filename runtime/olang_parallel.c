@@ -0,0 +1,213 @@
+// Olang parallel-for runtime (parallel for i in a..b)
+//
+// olc outlines the body of every `parallel for` into
+//     void body(int64_t lo, int64_t hi, void *env)
+// and calls __olang_parallel_for, which runs [lo, hi) on a persistent pool of
+// worker threads and returns once every iteration has run (the barrier). The
+// calling thread takes a share of the work too. The pool is started on first
+// use with OLANG_NUM_THREADS threads including the caller (default: online
+// CPUs). A parallel loop nested in another one, or started while another user
+// thread owns the pool, runs serially on the calling thread.
+//
+// schedule(static) splits the range into one contiguous block per thread;
+// schedule(static, c) deals chunks of c iterations round-robin;
+// schedule(dynamic, c) lets threads claim chunks of c from a shared counter
+// (default c: range / (8 * threads)).
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Must match ParallelForStmt::Schedule
+enum { SCHEDULE_STATIC = 0, SCHEDULE_DYNAMIC = 1 };
+
+#define MAX_THREADS 256
+#define SPIN_ITERATIONS 4000
+
+typedef void (*body_fn)(int64_t lo, int64_t hi, void *env);
+
+struct job {
+    body_fn fn;
+    void *env;
+    int64_t lo;
+    int64_t hi;
+    int schedule;
+    int64_t chunk;
+    _Atomic int64_t next;  // schedule(dynamic): first unclaimed iteration
+};
+
+static struct {
+    pthread_mutex_t owner;  // Held by the thread running a parallel loop
+    pthread_mutex_t lock;   // Protects the sleeping side of generation/pending
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    int threads;            // Including the calling thread
+    _Atomic uint64_t generation;
+    _Atomic int pending;    // Workers still running the current job
+    struct job job;
+} pool = {
+    .owner = PTHREAD_MUTEX_INITIALIZER,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+    .threads = 1,
+};
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static __thread int in_parallel;
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static inline int64_t min64(int64_t a, int64_t b) {
+    return a < b ? a : b;
+}
+
+// Run thread t's share of the current job
+static void run_share(struct job *job, int t, int threads) {
+    int64_t range = job->hi - job->lo;
+    if (job->schedule == SCHEDULE_DYNAMIC) {
+        for (;;) {
+            int64_t start = atomic_fetch_add_explicit(&job->next, job->chunk, memory_order_relaxed);
+            if (start >= job->hi) {
+                break;
+            }
+            job->fn(start, min64(start + job->chunk, job->hi), job->env);
+        }
+    } else if (job->chunk > 0) {
+        for (int64_t start = job->lo + t * job->chunk; start < job->hi; start += threads * job->chunk) {
+            job->fn(start, min64(start + job->chunk, job->hi), job->env);
+        }
+    } else {
+        int64_t block = range / threads;
+        int64_t extra = range % threads;
+        int64_t start = job->lo + t * block + min64(t, extra);
+        int64_t end = start + block + (t < extra ? 1 : 0);
+        if (start < end) {
+            job->fn(start, end, job->env);
+        }
+    }
+}
+
+static void *worker_main(void *arg) {
+    int t = (int)(intptr_t)arg;
+    uint64_t seen = 0;
+    in_parallel = 1;
+    for (;;) {
+        // Spin briefly for back-to-back loops, then sleep
+        uint64_t generation;
+        int spins = 0;
+        while ((generation = atomic_load_explicit(&pool.generation, memory_order_acquire)) == seen &&
+               spins++ < SPIN_ITERATIONS) {
+            cpu_relax();
+        }
+        if (generation == seen) {
+            pthread_mutex_lock(&pool.lock);
+            while ((generation = atomic_load_explicit(&pool.generation, memory_order_acquire)) == seen) {
+                pthread_cond_wait(&pool.wake, &pool.lock);
+            }
+            pthread_mutex_unlock(&pool.lock);
+        }
+        seen = generation;
+
+        run_share(&pool.job, t, pool.threads);
+
+        if (atomic_fetch_sub_explicit(&pool.pending, 1, memory_order_acq_rel) == 1) {
+            pthread_mutex_lock(&pool.lock);
+            pthread_cond_signal(&pool.done);
+            pthread_mutex_unlock(&pool.lock);
+        }
+    }
+    return NULL;
+}
+
+static void pool_start(void) {
+    long threads = 0;
+    const char *env = getenv("OLANG_NUM_THREADS");
+    if (env) {
+        threads = atol(env);
+    }
+    if (threads <= 0) {
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (threads < 1) threads = 1;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int started = 1;
+    for (int t = 1; t < threads; t++) {
+        pthread_t thread;
+        if (pthread_create(&thread, &attr, worker_main, (void *)(intptr_t)t) != 0) {
+            break;
+        }
+        started++;
+    }
+    pthread_attr_destroy(&attr);
+    pool.threads = started;
+}
+
+int olang_num_threads(void) {
+    pthread_once(&pool_once, pool_start);
+    return pool.threads;
+}
+
+void __olang_parallel_for(body_fn fn, int64_t lo, int64_t hi, void *env, int32_t schedule, int64_t chunk) {
+    if (lo >= hi) {
+        return;
+    }
+    pthread_once(&pool_once, pool_start);
+    if (in_parallel || pool.threads == 1 || pthread_mutex_trylock(&pool.owner) != 0) {
+        fn(lo, hi, env);
+        return;
+    }
+
+    int threads = pool.threads;
+    struct job *job = &pool.job;
+    job->fn = fn;
+    job->env = env;
+    job->lo = lo;
+    job->hi = hi;
+    job->schedule = schedule;
+    job->chunk = chunk;
+    if (schedule == SCHEDULE_DYNAMIC && chunk <= 0) {
+        job->chunk = (hi - lo) / (8 * threads);
+        if (job->chunk < 1) job->chunk = 1;
+    }
+    atomic_store_explicit(&job->next, lo, memory_order_relaxed);
+    atomic_store_explicit(&pool.pending, threads - 1, memory_order_relaxed);
+
+    // Publish the job (release orders the stores above before the new generation)
+    pthread_mutex_lock(&pool.lock);
+    atomic_fetch_add_explicit(&pool.generation, 1, memory_order_release);
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    in_parallel = 1;
+    run_share(job, 0, threads);
+    in_parallel = 0;
+
+    // Barrier: wait for the workers' shares
+    int spins = 0;
+    while (atomic_load_explicit(&pool.pending, memory_order_acquire) != 0 && spins++ < SPIN_ITERATIONS) {
+        cpu_relax();
+    }
+    if (atomic_load_explicit(&pool.pending, memory_order_acquire) != 0) {
+        pthread_mutex_lock(&pool.lock);
+        while (atomic_load_explicit(&pool.pending, memory_order_acquire) != 0) {
+            pthread_cond_wait(&pool.done, &pool.lock);
+        }
+        pthread_mutex_unlock(&pool.lock);
+    }
+
+    pthread_mutex_unlock(&pool.owner);
+}
@@ -0,0 +1,119 @@
+// Olang pool runtime (pool<T>, pool_alloc, pool_free)
+//
+// A global `let nodes: pool<Node> = 0;` is a thread-local free list
+// { head, count } whose links live in the first word of each free slot; olc
+// inlines the pop in pool_alloc and the push in pool_free. It also emits a
+// shared depot (nodes.depot) through which threads exchange free objects in
+// batches of POOL_BATCH, so producer/consumer patterns neither grow one
+// thread's list without bound nor starve the other:
+//
+//   - pool_alloc on an empty list takes a batch from the depot, or carves a
+//     new slab (SLAB_SIZE bytes of slots) when the depot is empty.
+//   - pool_free on a list of POOL_FLUSH objects moves POOL_BATCH of them to
+//     the depot.
+//
+// Slabs are never returned to the system: their objects may sit in any
+// thread's list.
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define POOL_FLUSH 256  // Must match POOL_FLUSH in src/codegen.cpp
+#define POOL_BATCH (POOL_FLUSH / 2)
+#define SLAB_SIZE (64 * 1024)
+
+struct pool_local {
+    void *head;
+    int64_t count;
+};
+
+// POOL_DEPOT_WORDS (src/codegen.cpp) 64-bit words, zero-initialized
+struct pool_depot {
+    int lock;
+    int64_t count;     // Batches in batches
+    int64_t capacity;
+    void **batches;    // Each a NULL-terminated list of POOL_BATCH objects
+};
+
+_Static_assert(sizeof(struct pool_depot) == 4 * sizeof(int64_t), "pool_depot must match POOL_DEPOT_WORDS");
+
+static void depot_lock(struct pool_depot *depot) {
+    while (__atomic_exchange_n(&depot->lock, 1, __ATOMIC_ACQUIRE)) {
+        while (__atomic_load_n(&depot->lock, __ATOMIC_RELAXED)) {
+            sched_yield();
+        }
+    }
+}
+
+static void depot_unlock(struct pool_depot *depot) {
+    __atomic_store_n(&depot->lock, 0, __ATOMIC_RELEASE);
+}
+
+static inline void *next_of(void *object) {
+    return *(void **)object;
+}
+
+void *__olang_pool_alloc(struct pool_local *local, struct pool_depot *depot, int64_t size, int64_t align) {
+    void *batch = NULL;
+    if (__atomic_load_n(&depot->count, __ATOMIC_RELAXED) > 0) {
+        depot_lock(depot);
+        if (depot->count > 0) {
+            batch = depot->batches[--depot->count];
+        }
+        depot_unlock(depot);
+    }
+
+    int64_t count = POOL_BATCH;
+    if (!batch) {
+        // New slab, linked in address order so the first allocations are adjacent
+        int64_t slots = SLAB_SIZE / size > 0 ? SLAB_SIZE / size : 1;
+        size_t bytes = (size_t)(slots * size);
+        char *slab = aligned_alloc((size_t)align, (bytes + (size_t)align - 1) & ~((size_t)align - 1));
+        if (!slab) {
+            fprintf(stderr, "olang: pool_alloc: out of memory\n");
+            abort();
+        }
+        for (int64_t i = 0; i < slots; i++) {
+            *(void **)(slab + i * size) = i + 1 < slots ? slab + (i + 1) * size : NULL;
+        }
+        batch = slab;
+        count = slots;
+    }
+
+    local->head = next_of(batch);
+    local->count = count - 1;
+    return batch;
+}
+
+void __olang_pool_free(struct pool_local *local, struct pool_depot *depot, void *object) {
+    *(void **)object = local->head;
+    local->head = object;
+    local->count++;
+
+    // Keep the most recently freed (cache-warm) objects, hand on the oldest POOL_BATCH
+    void *keep_last = local->head;
+    for (int64_t i = 1; i < local->count - POOL_BATCH; i++) {
+        keep_last = next_of(keep_last);
+    }
+    void *batch = next_of(keep_last);
+    *(void **)keep_last = NULL;
+    local->count -= POOL_BATCH;
+
+    depot_lock(depot);
+    if (depot->count == depot->capacity) {
+        int64_t capacity = depot->capacity ? depot->capacity * 2 : 16;
+        void **batches = realloc(depot->batches, (size_t)capacity * sizeof(void *));
+        if (!batches) {
+            depot_unlock(depot);
+            fprintf(stderr, "olang: pool_free: out of memory\n");
+            abort();
+        }
+        depot->batches = batches;
+        depot->capacity = capacity;
+    }
+    depot->batches[depot->count++] = batch;
+    depot_unlock(depot);
+}
@@ -0,0 +1,107 @@
+// Olang function profile runtime (--instrument-functions)
+//
+// olc emits one olang_prof_record per instrumented function into the
+// "olang_prof" section and registers __olang_prof_init as a global
+// constructor. At exit the records are dumped as a flat profile, sorted by
+// cycles (timing mode) or by call count (counts mode).
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Must match the record layout emitted by CodeGenContext::instrumentFunctionEntry
+struct olang_prof_record {
+    uint64_t calls;
+    uint64_t cycles;
+    const char *name;
+};
+
+// Provided by the linker for the "olang_prof" section
+extern struct olang_prof_record __start_olang_prof[] __attribute__((weak));
+extern struct olang_prof_record __stop_olang_prof[] __attribute__((weak));
+
+static int has_cycles;
+
+static int compare_records(const void *a, const void *b) {
+    const struct olang_prof_record *ra = *(const struct olang_prof_record *const *)a;
+    const struct olang_prof_record *rb = *(const struct olang_prof_record *const *)b;
+    uint64_t ka = has_cycles ? ra->cycles : ra->calls;
+    uint64_t kb = has_cycles ? rb->cycles : rb->calls;
+    if (ka != kb) {
+        return ka < kb ? 1 : -1;
+    }
+    if (ra->calls != rb->calls) {
+        return ra->calls < rb->calls ? 1 : -1;
+    }
+    return 0;
+}
+
+static void olang_prof_dump(void) {
+    size_t count = (size_t)(__stop_olang_prof - __start_olang_prof);
+    if (count == 0) {
+        return;
+    }
+
+    struct olang_prof_record **sorted = malloc(count * sizeof(*sorted));
+    if (!sorted) {
+        return;
+    }
+
+    uint64_t total_cycles = 0;
+    uint64_t total_calls = 0;
+    size_t used = 0;
+    for (size_t i = 0; i < count; i++) {
+        struct olang_prof_record *record = &__start_olang_prof[i];
+        total_cycles += record->cycles;
+        total_calls += record->calls;
+        if (record->calls > 0) {
+            sorted[used++] = record;
+        }
+    }
+    has_cycles = total_cycles > 0;
+    qsort(sorted, used, sizeof(*sorted), compare_records);
+
+    // OLANG_PROF_OUT redirects the report to a file (default: stderr)
+    FILE *out = stderr;
+    const char *path = getenv("OLANG_PROF_OUT");
+    if (path && *path) {
+        FILE *file = fopen(path, "w");
+        if (file) {
+            out = file;
+        }
+    }
+
+    fprintf(out, "olang flat profile (%s, %llu calls)\n", has_cycles ? "timing" : "counts",
+            (unsigned long long)total_calls);
+    if (has_cycles) {
+        fprintf(out, "%8s %16s %12s %14s  %s\n", "%cycles", "cycles", "calls", "cycles/call", "function");
+        for (size_t i = 0; i < used; i++) {
+            const struct olang_prof_record *record = sorted[i];
+            fprintf(out, "%7.2f%% %16llu %12llu %14.1f  %s\n",
+                    100.0 * (double)record->cycles / (double)total_cycles,
+                    (unsigned long long)record->cycles, (unsigned long long)record->calls,
+                    (double)record->cycles / (double)record->calls, record->name);
+        }
+        fprintf(out, "note: cycles include callees\n");
+    } else {
+        fprintf(out, "%8s %12s  %s\n", "%calls", "calls", "function");
+        for (size_t i = 0; i < used; i++) {
+            const struct olang_prof_record *record = sorted[i];
+            fprintf(out, "%7.2f%% %12llu  %s\n",
+                    100.0 * (double)record->calls / (double)total_calls,
+                    (unsigned long long)record->calls, record->name);
+        }
+    }
+    if (out != stderr) {
+        fclose(out);
+    }
+    free(sorted);
+}
+
+void __olang_prof_init(void) {
+    static int registered = 0;
+    if (!registered) {
+        registered = 1;
+        atexit(olang_prof_dump);
+    }
+}
@@ -0,0 +1,331 @@
+// Olang task runtime (spawn / join / sync)
+//
+// `spawn f(args)` allocates a task whose payload holds f's result followed by
+// its arguments, fills it in and hands it to __olang_task_spawn together with
+// a thunk that calls f. Tasks are pushed onto the spawning thread's Chase-Lev
+// deque (Le, Pop, Cohen, Zappa Nardelli: "Correct and Efficient Work-Stealing
+// for Weak Memory Models", PPoPP'13). The owner pushes and pops at the bottom
+// (LIFO, cache-warm); idle workers steal the oldest task from the top of a
+// random victim's deque, which for divide-and-conquer code is the largest
+// piece of remaining work.
+//
+// join(h) and sync do not block while there is work: the waiting thread runs
+// tasks from its own deque and steals from others until the awaited tasks
+// are done. Every task belongs to the task scope of the function that
+// spawned it; sync (explicit, or implicit when the function returns) joins
+// all of them and frees their memory, so handles are valid until then. The
+// compiler keeps handles in local variables of the spawning function and
+// nulls them at sync, so a join after the memory is gone aborts.
+//
+// Workers (OLANG_NUM_THREADS - 1, default: online CPUs - 1) start on the
+// first spawn. A thread without a deque slot, or whose deque is full, runs
+// the task inline, which preserves the program's meaning.
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_DEQUES 256
+#define DEQUE_SIZE 8192  // Power of two
+#define STEAL_ROUNDS 64
+#define SLEEP_NS 50000000
+
+struct task {
+    void (*thunk)(void *payload);
+    struct task *next_in_scope;
+    _Atomic int done;
+} __attribute__((aligned(16)));
+
+struct deque {
+    _Alignas(64) _Atomic int64_t top;     // Thieves take from here
+    _Alignas(64) _Atomic int64_t bottom;  // Owner pushes and pops here
+    _Alignas(64) struct task *_Atomic buffer[DEQUE_SIZE];
+};
+
+static struct deque *_Atomic deques[MAX_DEQUES];
+static _Atomic int deque_count;
+
+static pthread_once_t workers_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t sleep_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sleep_cond = PTHREAD_COND_INITIALIZER;
+static _Atomic int sleepers;
+static _Atomic uint64_t work_signal;
+
+static __thread struct deque *my_deque;
+static __thread int has_deque_slot;  // 0: not yet assigned, 1: assigned, -1: none left
+static __thread uint64_t rng_state;
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static inline void *payload_of(struct task *task) {
+    return (char *)task + sizeof(struct task);
+}
+
+static inline struct task *task_of(void *payload) {
+    return (struct task *)((char *)payload - sizeof(struct task));
+}
+
+static struct deque *get_deque(void) {
+    if (has_deque_slot == 0) {
+        has_deque_slot = -1;
+        int index = atomic_fetch_add(&deque_count, 1);
+        if (index < MAX_DEQUES) {
+            struct deque *deque = aligned_alloc(64, sizeof(struct deque));
+            if (deque) {
+                atomic_init(&deque->top, 0);
+                atomic_init(&deque->bottom, 0);
+                atomic_store_explicit(&deques[index], deque, memory_order_release);
+                my_deque = deque;
+                has_deque_slot = 1;
+            }
+        }
+        rng_state = (uint64_t)(uintptr_t)&rng_state ^ ((uint64_t)index << 32) ^ 0x9e3779b97f4a7c15ull;
+    }
+    return my_deque;
+}
+
+// Owner: push at the bottom (0 if the deque is full)
+static int deque_push(struct deque *deque, struct task *task) {
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    if (bottom - top >= DEQUE_SIZE) {
+        return 0;
+    }
+    atomic_store_explicit(&deque->buffer[bottom & (DEQUE_SIZE - 1)], task, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    return 1;
+}
+
+// Owner: pop the newest task
+static struct task *deque_take(struct deque *deque) {
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    struct task *task = NULL;
+    if (top <= bottom) {
+        task = atomic_load_explicit(&deque->buffer[bottom & (DEQUE_SIZE - 1)], memory_order_relaxed);
+        if (top == bottom) {
+            // Last task: race against thieves for it
+            if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst,
+                                                         memory_order_relaxed)) {
+                task = NULL;
+            }
+            atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        }
+    } else {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+// Thief: take the oldest task
+static struct task *deque_steal(struct deque *deque) {
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (top >= bottom) {
+        return NULL;
+    }
+    struct task *task = atomic_load_explicit(&deque->buffer[top & (DEQUE_SIZE - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst,
+                                                 memory_order_relaxed)) {
+        return NULL;
+    }
+    return task;
+}
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// One pass over the other deques, starting at a random victim
+static struct task *steal_any(void) {
+    int count = atomic_load_explicit(&deque_count, memory_order_acquire);
+    if (count > MAX_DEQUES) {
+        count = MAX_DEQUES;
+    }
+    if (count == 0) {
+        return NULL;
+    }
+    int start = (int)(next_random() % (uint64_t)count);
+    for (int i = 0; i < count; i++) {
+        struct deque *victim = atomic_load_explicit(&deques[(start + i) % count], memory_order_acquire);
+        if (victim && victim != my_deque) {
+            struct task *task = deque_steal(victim);
+            if (task) {
+                return task;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void run_task(struct task *task) {
+    task->thunk(payload_of(task));
+    atomic_store_explicit(&task->done, 1, memory_order_release);
+}
+
+// Run one available task (own deque first); 0 if none was found
+static int run_one(void) {
+    struct task *task = my_deque ? deque_take(my_deque) : NULL;
+    if (!task) {
+        task = steal_any();
+    }
+    if (!task) {
+        return 0;
+    }
+    run_task(task);
+    return 1;
+}
+
+static void *worker_main(void *arg) {
+    (void)arg;
+    get_deque();
+    for (;;) {
+        int found = 0;
+        for (int round = 0; round < STEAL_ROUNDS && !found; round++) {
+            found = run_one();
+            if (!found) {
+                cpu_relax();
+            }
+        }
+        if (found) {
+            continue;
+        }
+
+        // Announce sleeping, then look once more: a spawn that did not see us
+        // sleeping published its task before our check (see wake_sleepers)
+        atomic_fetch_add_explicit(&sleepers, 1, memory_order_seq_cst);
+        uint64_t signal = atomic_load_explicit(&work_signal, memory_order_seq_cst);
+        if (run_one()) {
+            atomic_fetch_sub_explicit(&sleepers, 1, memory_order_relaxed);
+            continue;
+        }
+        pthread_mutex_lock(&sleep_lock);
+        if (atomic_load_explicit(&work_signal, memory_order_relaxed) == signal) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += SLEEP_NS;
+            if (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&sleep_cond, &sleep_lock, &deadline);
+        }
+        pthread_mutex_unlock(&sleep_lock);
+        atomic_fetch_sub_explicit(&sleepers, 1, memory_order_relaxed);
+    }
+    return NULL;
+}
+
+static void start_workers(void) {
+    long threads = 0;
+    const char *env = getenv("OLANG_NUM_THREADS");
+    if (env) {
+        threads = atol(env);
+    }
+    if (threads <= 0) {
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (threads > MAX_DEQUES / 2) {
+        threads = MAX_DEQUES / 2;
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (long i = 1; i < threads; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, &attr, worker_main, NULL) != 0) {
+            break;
+        }
+    }
+    pthread_attr_destroy(&attr);
+}
+
+static void wake_sleepers(void) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&sleepers, memory_order_relaxed) > 0) {
+        pthread_mutex_lock(&sleep_lock);
+        atomic_fetch_add_explicit(&work_signal, 1, memory_order_relaxed);
+        pthread_cond_signal(&sleep_cond);
+        pthread_mutex_unlock(&sleep_lock);
+    }
+}
+
+void *__olang_task_alloc(int64_t payload_size) {
+    struct task *task = malloc(sizeof(struct task) + (size_t)payload_size);
+    if (!task) {
+        abort();
+    }
+    return payload_of(task);
+}
+
+void __olang_task_spawn(struct task **scope, void (*thunk)(void *payload), void *payload) {
+    struct task *task = task_of(payload);
+    task->thunk = thunk;
+    task->next_in_scope = *scope;
+    atomic_init(&task->done, 0);
+    *scope = task;
+
+    pthread_once(&workers_once, start_workers);
+    struct deque *deque = get_deque();
+    if (!deque || !deque_push(deque, task)) {
+        run_task(task);
+        return;
+    }
+    wake_sleepers();
+}
+
+void __olang_task_join(void *payload) {
+    // sync nulls the handles of the tasks it freed
+    if (!payload) {
+        fputs("olang: join of a task that was already synced (or never spawned)\n", stderr);
+        abort();
+    }
+    struct task *task = task_of(payload);
+    get_deque();
+    int idle = 0;
+    while (!atomic_load_explicit(&task->done, memory_order_acquire)) {
+        if (run_one()) {
+            idle = 0;
+        } else if (++idle < 1000) {
+            cpu_relax();
+        } else {
+            sched_yield();
+        }
+    }
+}
+
+void __olang_task_sync(struct task **scope) {
+    struct task *task = *scope;
+    if (!task) {
+        return;
+    }
+    for (struct task *t = task; t; t = t->next_in_scope) {
+        __olang_task_join(payload_of(t));
+    }
+    while (task) {
+        struct task *next = task->next_in_scope;
+        free(task);
+        task = next;
+    }
+    *scope = NULL;
+}
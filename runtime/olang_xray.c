@@ -0,0 +1,340 @@
+// Olang XRay runtime (--xray)
+//
+// olc marks functions with "xray-instruction-threshold", so LLVM emits
+// patchable entry/exit sleds (two-byte jumps over nops) and describes them in
+// the xray_instr_map section. While tracing is off the sleds cost a couple of
+// cycles. olang_xray_start() patches the sleds to call the trampolines in
+// olang_xray_x86_64.S; olang_xray_stop() restores them and writes the trace.
+//
+// Tracing can also be toggled on a live process with a signal: the first
+// SIGUSR2 starts tracing, the second stops it and writes the trace to
+// $OLANG_XRAY_OUT (default olang-xray.<pid>.bin). OLANG_XRAY_SIGNAL=<signo>
+// selects a different signal, OLANG_XRAY_SIGNAL=0 disables the handler.
+//
+// Trace file layout (little endian):
+//   struct olang_xray_header
+//   uint64_t function_address[num_functions]   (function id N at index N-1)
+//   struct olang_xray_event  events[num_events]
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// Sled descriptor emitted by LLVM into xray_instr_map
+struct xray_sled {
+    int64_t address;
+    int64_t function;
+    uint8_t kind;
+    uint8_t always_instrument;
+    uint8_t version;
+    uint8_t padding[13];
+};
+
+enum { SLED_ENTRY = 0, SLED_EXIT = 1, SLED_TAIL = 2, SLED_LOG_ARGS_ENTRY = 3 };
+
+struct olang_xray_header {
+    char magic[8];             // "OLXRAY1"
+    uint64_t cycles_per_second;
+    uint32_t num_functions;
+    uint32_t reserved;
+    uint64_t num_events;
+    uint64_t dropped_events;
+};
+
+struct olang_xray_event {
+    uint64_t tsc;
+    uint32_t function_id;
+    uint32_t tid;
+    uint8_t kind;              // 0 entry, 1 exit, 2 tail exit
+    uint8_t padding[7];
+};
+
+extern struct xray_sled __start_xray_instr_map[] __attribute__((weak));
+extern struct xray_sled __stop_xray_instr_map[] __attribute__((weak));
+
+void __olang_xray_entry_trampoline(void);
+void __olang_xray_exit_trampoline(void);
+void __olang_xray_tail_trampoline(void);
+
+static uint32_t *sled_function_id;
+static uint64_t *function_address;
+static uint32_t num_functions;
+
+static struct olang_xray_event *events;
+static uint64_t event_capacity;
+static uint64_t event_count;
+static uint64_t dropped_count;
+static uint64_t start_tsc;
+static struct timespec start_time;
+
+static volatile int tracing;
+static int xray_signal = SIGUSR2;
+static __thread uint32_t cached_tid;
+
+static uintptr_t sled_address(const struct xray_sled *sled) {
+    // Version 2 sleds store addresses relative to the field itself
+    if (sled->version >= 2) {
+        return (uintptr_t)&sled->address + (uintptr_t)sled->address;
+    }
+    return (uintptr_t)sled->address;
+}
+
+static uintptr_t sled_function(const struct xray_sled *sled) {
+    if (sled->version >= 2) {
+        return (uintptr_t)&sled->function + (uintptr_t)sled->function;
+    }
+    return (uintptr_t)sled->function;
+}
+
+__attribute__((visibility("hidden")))
+void __olang_xray_handle_event(uint32_t function_id, uint32_t kind) {
+    if (!tracing) {
+        return;
+    }
+    uint64_t index = __atomic_fetch_add(&event_count, 1, __ATOMIC_RELAXED);
+    if (index >= event_capacity) {
+        __atomic_fetch_add(&dropped_count, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    if (cached_tid == 0) {
+        cached_tid = (uint32_t)syscall(SYS_gettid);
+    }
+    struct olang_xray_event *event = &events[index];
+    event->tsc = __builtin_ia32_rdtsc();
+    event->function_id = function_id;
+    event->tid = cached_tid;
+    event->kind = (uint8_t)kind;
+}
+
+// Assign function ids (sleds of one function are contiguous in the map)
+static int index_sleds(void) {
+    size_t count = (size_t)(__stop_xray_instr_map - __start_xray_instr_map);
+    if (count == 0 || sled_function_id) {
+        return count == 0 ? -1 : 0;
+    }
+    sled_function_id = calloc(count, sizeof(*sled_function_id));
+    function_address = calloc(count, sizeof(*function_address));
+    if (!sled_function_id || !function_address) {
+        return -1;
+    }
+    uintptr_t previous = 0;
+    for (size_t i = 0; i < count; i++) {
+        uintptr_t function = sled_function(&__start_xray_instr_map[i]);
+        if (function != previous) {
+            function_address[num_functions++] = function;
+            previous = function;
+        }
+        sled_function_id[i] = num_functions;
+    }
+    return 0;
+}
+
+static int set_text_protection(int prot) {
+    size_t count = (size_t)(__stop_xray_instr_map - __start_xray_instr_map);
+    uintptr_t low = UINTPTR_MAX;
+    uintptr_t high = 0;
+    for (size_t i = 0; i < count; i++) {
+        uintptr_t address = sled_address(&__start_xray_instr_map[i]);
+        if (address < low) low = address;
+        if (address + 16 > high) high = address + 16;
+    }
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    low &= ~(page - 1);
+    return mprotect((void *)low, high - low, prot);
+}
+
+static void patch_sled(const struct xray_sled *sled, uint32_t function_id, int enable) {
+    uint8_t *address = (uint8_t *)sled_address(sled);
+    uintptr_t trampoline;
+    uint8_t opcode;
+    switch (sled->kind) {
+        case SLED_ENTRY:
+        case SLED_LOG_ARGS_ENTRY:
+            trampoline = (uintptr_t)__olang_xray_entry_trampoline;
+            opcode = 0xe8; // call rel32
+            break;
+        case SLED_TAIL:
+            trampoline = (uintptr_t)__olang_xray_tail_trampoline;
+            opcode = 0xe8;
+            break;
+        case SLED_EXIT:
+            trampoline = (uintptr_t)__olang_xray_exit_trampoline;
+            opcode = 0xe9; // jmp rel32
+            break;
+        default:
+            return; // Custom/typed event sleds are not used by olc
+    }
+
+    if (!enable) {
+        if (sled->kind == SLED_EXIT) {
+            __atomic_store_n(address, (uint8_t)0xc3, __ATOMIC_RELEASE);        // ret
+        } else {
+            __atomic_store_n((uint16_t *)address, (uint16_t)0x09eb, __ATOMIC_RELEASE); // jmp +9
+        }
+        return;
+    }
+
+    int64_t offset = (int64_t)trampoline - (int64_t)((uintptr_t)address + 11);
+    if (offset < INT32_MIN || offset > INT32_MAX) {
+        return;
+    }
+    // mov r10d, <id>; call/jmp <trampoline>. The first two bytes are written
+    // last, atomically, so a thread executing the sled sees either version.
+    int32_t rel = (int32_t)offset;
+    memcpy(address + 2, &function_id, sizeof(function_id));
+    address[6] = opcode;
+    memcpy(address + 7, &rel, sizeof(rel));
+    __atomic_store_n((uint16_t *)address, (uint16_t)0xba41, __ATOMIC_RELEASE);
+}
+
+static int patch_all(int enable) {
+    if (set_text_protection(PROT_READ | PROT_WRITE | PROT_EXEC) != 0) {
+        return -1;
+    }
+    size_t count = (size_t)(__stop_xray_instr_map - __start_xray_instr_map);
+    for (size_t i = 0; i < count; i++) {
+        patch_sled(&__start_xray_instr_map[i], sled_function_id[i], enable);
+    }
+    set_text_protection(PROT_READ | PROT_EXEC);
+    return 0;
+}
+
+// Pages of the event buffer are only touched once tracing writes to them
+static int allocate_events(void) {
+    if (events) {
+        return 0;
+    }
+    event_capacity = 1u << 20;
+    const char *capacity = getenv("OLANG_XRAY_EVENTS");
+    if (capacity && atoll(capacity) > 0) {
+        event_capacity = (uint64_t)atoll(capacity);
+    }
+    void *buffer = mmap(NULL, event_capacity * sizeof(*events), PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer == MAP_FAILED) {
+        return -1;
+    }
+    events = buffer;
+    return 0;
+}
+
+int32_t olang_xray_start(void) {
+    if (tracing) {
+        return 0;
+    }
+    if (index_sleds() != 0 || allocate_events() != 0) {
+        return -1;
+    }
+    event_count = 0;
+    dropped_count = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    start_tsc = __builtin_ia32_rdtsc();
+    tracing = 1;
+    return patch_all(1);
+}
+
+static int write_all(int fd, const void *data, size_t size) {
+    const char *p = data;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+// Async-signal-safe apart from the trace file write, which only uses open/write
+int32_t olang_xray_stop(const char *path) {
+    if (!tracing) {
+        return -1;
+    }
+    patch_all(0);
+    tracing = 0;
+
+    struct timespec end_time;
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    uint64_t elapsed_tsc = __builtin_ia32_rdtsc() - start_tsc;
+    double elapsed_sec = (double)(end_time.tv_sec - start_time.tv_sec) +
+                         (double)(end_time.tv_nsec - start_time.tv_nsec) * 1e-9;
+
+    struct olang_xray_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "OLXRAY1", 8);
+    header.cycles_per_second = elapsed_sec > 0 ? (uint64_t)((double)elapsed_tsc / elapsed_sec) : 0;
+    header.num_functions = num_functions;
+    header.num_events = event_count < event_capacity ? event_count : event_capacity;
+    header.dropped_events = dropped_count;
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    int result = write_all(fd, &header, sizeof(header));
+    if (result == 0) {
+        result = write_all(fd, function_address, num_functions * sizeof(*function_address));
+    }
+    if (result == 0) {
+        result = write_all(fd, events, header.num_events * sizeof(*events));
+    }
+    close(fd);
+    return result;
+}
+
+static void default_trace_path(char *buffer, size_t size) {
+    const char *path = getenv("OLANG_XRAY_OUT");
+    if (path && *path) {
+        snprintf(buffer, size, "%s", path);
+    } else {
+        snprintf(buffer, size, "olang-xray.%d.bin", (int)getpid());
+    }
+}
+
+static char signal_trace_path[4096];
+
+static void toggle_handler(int signo) {
+    (void)signo;
+    if (tracing) {
+        olang_xray_stop(signal_trace_path);
+    } else {
+        olang_xray_start();
+    }
+}
+
+void __olang_xray_init(void) {
+    static int initialized = 0;
+    if (initialized) {
+        return;
+    }
+    initialized = 1;
+
+    const char *signal_env = getenv("OLANG_XRAY_SIGNAL");
+    if (signal_env && *signal_env) {
+        xray_signal = atoi(signal_env);
+    }
+    if (xray_signal <= 0) {
+        return;
+    }
+
+    // Resolve the trace path, sled table and buffer up front, outside signal context
+    default_trace_path(signal_trace_path, sizeof(signal_trace_path));
+    index_sleds();
+    allocate_events();
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = toggle_handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(xray_signal, &action, NULL);
+}
@@ -1,4 +1,5 @@
 #include "codegen.h"
+#include "passes.h"
 #include <llvm/IR/Verifier.h>
 #include <llvm/IR/LegacyPassManager.h>
 #include <llvm/Support/raw_ostream.h>
@@ -8,10 +9,57 @@
 #include <llvm/Target/TargetOptions.h>
 #include <llvm/MC/TargetRegistry.h>
 #include <llvm/TargetParser/Host.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/InlineAsm.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <algorithm>
 
 namespace olang {
 
+// Mark the struct named by type (through pointers and arrays) as crossing the extern boundary
+static void markBoundaryStruct(const Type& type, std::unordered_map<std::string, StructDecl*>& structs) {
+    if (type.kind == TypeKind::POINTER || type.kind == TypeKind::ARRAY || type.kind == TypeKind::SLICE) {
+        markBoundaryStruct(*type.element_type, structs);
+        return;
+    }
+    if (type.kind != TypeKind::STRUCT) {
+        return;
+    }
+    auto it = structs.find(type.name);
+    if (it == structs.end() || it->second->crosses_boundary) {
+        return;
+    }
+    it->second->crosses_boundary = true;
+    for (const auto& field : it->second->fields) {
+        markBoundaryStruct(field.first, structs);
+    }
+}
+
 llvm::Value* Program::codegen(CodeGenContext& ctx) {
+    // Structs reachable from extern and export signatures keep their declared layout
+    std::unordered_map<std::string, StructDecl*> structs;
+    for (auto& decl : declarations) {
+        if (auto struct_decl = dynamic_cast<StructDecl*>(decl.get())) {
+            structs[struct_decl->name] = struct_decl;
+        }
+    }
+    for (auto& decl : declarations) {
+        if (auto extern_decl = dynamic_cast<ExternDecl*>(decl.get())) {
+            for (const auto& param : extern_decl->params) {
+                markBoundaryStruct(param.first, structs);
+            }
+            markBoundaryStruct(extern_decl->return_type, structs);
+        } else if (auto func_decl = dynamic_cast<FunctionDecl*>(decl.get())) {
+            if (func_decl->is_export) {
+                for (const auto& param : func_decl->params) {
+                    markBoundaryStruct(param.first, structs);
+                }
+                markBoundaryStruct(func_decl->return_type, structs);
+            }
+        }
+    }
+    
     // Generate all struct declarations
     for (auto& decl : declarations) {
         if (auto struct_decl = dynamic_cast<StructDecl*>(decl.get())) {
@@ -19,6 +67,13 @@ llvm::Value* Program::codegen(CodeGenContext& ctx) {
         }
     }
     
+    // Generate all global variables
+    for (auto& decl : declarations) {
+        if (auto global_decl = dynamic_cast<GlobalVarDecl*>(decl.get())) {
+            global_decl->codegen(ctx);
+        }
+    }
+    
     // Generate all external function declarations
     for (auto& decl : declarations) {
         if (auto extern_decl = dynamic_cast<ExternDecl*>(decl.get())) {
@@ -27,40 +82,310 @@ llvm::Value* Program::codegen(CodeGenContext& ctx) {
     }
     
     // Generate all function declarations
+    std::vector<llvm::Function*> benches;
     for (auto& decl : declarations) {
         if (auto func_decl = dynamic_cast<FunctionDecl*>(decl.get())) {
-            func_decl->codegen(ctx);
+            if (func_decl->is_bench) {
+                // Bench functions are only compiled with --bench
+                if (!ctx.isBenchMode()) {
+                    continue;
+                }
+                if (func_decl->params.size() != 1 || func_decl->params[0].first.kind != TypeKind::I64 ||
+                    func_decl->return_type.kind != TypeKind::VOID) {
+                    ctx.error() << "bench fn " << func_decl->name
+                                << " must take a single iters: i64 parameter and return nothing\n";
+                    continue;
+                }
+                if (auto function = llvm::dyn_cast_or_null<llvm::Function>(func_decl->codegen(ctx))) {
+                    benches.push_back(function);
+                }
+            } else if (ctx.isBenchMode() && func_decl->name == "main") {
+                // The generated bench driver is main
+                ctx.error() << "main cannot be defined with --bench (the benchmark driver is main)\n";
+            } else {
+                func_decl->codegen(ctx);
+            }
         }
     }
     
+    if (ctx.isBenchMode()) {
+        ctx.emitBenchDriver(benches);
+    }
+    
     return nullptr;
 }
 
+// N of an #[align(N)] attribute; 0 if absent or not a power of two
+static uint64_t getAlignAttribute(CodeGenContext& ctx, const std::vector<Attribute>& attributes,
+                                  const std::string& owner) {
+    const Attribute* attribute = findAttribute(attributes, "align");
+    if (!attribute) {
+        return 0;
+    }
+    uint64_t align = 0;
+    if (attribute->args.size() == 1 && !llvm::StringRef(attribute->args[0]).getAsInteger(10, align) &&
+        llvm::isPowerOf2_64(align)) {
+        return align;
+    }
+    ctx.error() << "#[align(N)] on " << owner << " needs a power of two N\n";
+    return 0;
+}
+
 llvm::Value* StructDecl::codegen(CodeGenContext& ctx) {
+    const llvm::DataLayout& data_layout = ctx.getModule()->getDataLayout();
+    bool packed = findAttribute(attributes, "packed") != nullptr;
+    
+    // Required alignment of each field: its type's (1 when packed), raised by #[align(N)]
+    std::vector<llvm::Type*> declared_types;
+    std::vector<uint64_t> field_aligns;
+    for (size_t i = 0; i < fields.size(); ++i) {
+        if (fields[i].first.kind == TypeKind::TASK) {
+            ctx.error() << "field " << name << "." << fields[i].second << ": task handles live in local variables\n";
+            return nullptr;
+        }
+        declared_types.push_back(ctx.getLLVMType(fields[i].first));
+        uint64_t align = packed ? 1 : ctx.getTypeAlign(fields[i].first).value();
+        if (i < field_attributes.size()) {
+            align = std::max(align, getAlignAttribute(ctx, field_attributes[i], name + "." + fields[i].second));
+        }
+        field_aligns.push_back(align);
+    }
+    
+    // Memory order of the fields (indices into the declaration)
+    std::vector<unsigned> order;
+    for (unsigned i = 0; i < fields.size(); ++i) {
+        order.push_back(i);
+    }
+    
+    bool reorder = findAttribute(attributes, "reorder") != nullptr;
+    if (reorder && crosses_boundary) {
+        llvm::errs() << "Warning: struct " << name
+                     << " is used by an extern or export function, keeping declared field order\n";
+    }
+    if ((reorder || ctx.isReorderFields()) && !crosses_boundary) {
+        // Decreasing alignment, then decreasing size: no interior padding for scalar fields
+        std::stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b) {
+            if (field_aligns[a] != field_aligns[b]) {
+                return field_aligns[a] > field_aligns[b];
+            }
+            return static_cast<uint64_t>(data_layout.getTypeAllocSize(declared_types[a])) >
+                   static_cast<uint64_t>(data_layout.getTypeAllocSize(declared_types[b]));
+        });
+    }
+    
+    // Lay out the fields, inserting i8 arrays wherever LLVM's own layout would
+    // under-align a field (packed structs, #[align(N)], over-aligned struct fields)
+    llvm::Type* i8_type = llvm::Type::getInt8Ty(ctx.getContext());
     std::vector<llvm::Type*> field_types;
-    for (const auto& field : fields) {
-        field_types.push_back(ctx.getLLVMType(field.first));
+    std::vector<unsigned> field_index(fields.size());
+    uint64_t offset = 0;
+    uint64_t struct_align = 1;
+    for (unsigned i : order) {
+        uint64_t natural = packed ? 1 : data_layout.getABITypeAlign(declared_types[i]).value();
+        uint64_t padded = llvm::alignTo(offset, field_aligns[i]);
+        if (padded > llvm::alignTo(offset, natural)) {
+            field_types.push_back(llvm::ArrayType::get(i8_type, padded - offset));
+            offset = padded;
+        }
+        offset = llvm::alignTo(offset, natural);
+        field_index[i] = field_types.size();
+        field_types.push_back(declared_types[i]);
+        offset += data_layout.getTypeAllocSize(declared_types[i]);
+        struct_align = std::max(struct_align, field_aligns[i]);
+    }
+    struct_align = std::max(struct_align, getAlignAttribute(ctx, attributes, "struct " + name));
+    
+    // Tail padding so array elements stay aligned
+    uint64_t size = llvm::alignTo(offset, struct_align);
+    uint64_t llvm_size = data_layout.getTypeAllocSize(llvm::StructType::get(ctx.getContext(), field_types, packed));
+    if (size > llvm_size) {
+        field_types.push_back(llvm::ArrayType::get(i8_type, size - llvm_size));
     }
     
     llvm::StructType* struct_type = llvm::StructType::create(
-        ctx.getContext(), field_types, name
+        ctx.getContext(), field_types, name, packed
     );
     
     ctx.addStructType(name, Type(TypeKind::STRUCT, name), struct_type);
     
+    StructInfo info;
+    info.name = name;
+    info.fields = fields;
+    info.field_index = field_index;
+    info.llvm_type = struct_type;
+    info.align = llvm::Align(struct_align);
+    ctx.addStructInfo(info);
+    
     return nullptr;
 }
 
+// Offset of the promise in a coroutine frame, after the resume and destroy
+// function pointers: must match PROMISE_OFFSET in runtime/olang_async.c
+static const uint64_t PROMISE_OFFSET = 16;
+
+// { continuation, leaf_result, flags, result }: must match struct promise in runtime/olang_async.c
+static llvm::StructType* getPromiseType(CodeGenContext& ctx, const Type& result) {
+    std::vector<llvm::Type*> fields = {
+        llvm::PointerType::get(ctx.getContext(), 0),
+        llvm::Type::getInt64Ty(ctx.getContext()),
+        llvm::Type::getInt64Ty(ctx.getContext())
+    };
+    if (result.kind != TypeKind::VOID) {
+        fields.push_back(ctx.getLLVMType(result));
+    }
+    return llvm::StructType::get(ctx.getContext(), fields);
+}
+
+// Suspend the current coroutine; generation continues in a new block that runs once it is resumed
+static void emitSuspend(CodeGenContext& ctx, AsyncFrame& frame, const std::string& name) {
+    llvm::IRBuilder<>& builder = ctx.getBuilder();
+    llvm::Value* state = builder.CreateCall(
+        llvm::Intrinsic::getDeclaration(ctx.getModule(), llvm::Intrinsic::coro_suspend),
+        {llvm::ConstantTokenNone::get(ctx.getContext()), builder.getFalse()}
+    );
+    llvm::BasicBlock* resume_block = llvm::BasicBlock::Create(
+        ctx.getContext(), name, builder.GetInsertBlock()->getParent()
+    );
+    llvm::SwitchInst* dispatch = builder.CreateSwitch(state, frame.suspend_block, 2);
+    dispatch->addCase(builder.getInt8(0), resume_block);
+    dispatch->addCase(builder.getInt8(1), frame.cleanup_block);
+    builder.SetInsertPoint(resume_block);
+}
+
+// Coroutine ramp: allocate the frame (unless CoroElide removes the allocation),
+// clear the promise and suspend before the body, so the caller decides when it runs
+static bool emitAsyncPrologue(CodeGenContext& ctx, llvm::Function* function, const Type& result, AsyncFrame& frame) {
+    llvm::IRBuilder<>& builder = ctx.getBuilder();
+    llvm::Module* module = ctx.getModule();
+    llvm::LLVMContext& context = ctx.getContext();
+    llvm::PointerType* ptr_type = llvm::PointerType::get(context, 0);
+    
+    frame.promise_type = getPromiseType(ctx, result);
+    llvm::Align promise_align = module->getDataLayout().getABITypeAlign(frame.promise_type);
+    if (promise_align.value() > PROMISE_OFFSET) {
+        ctx.error() << "async fn " << function->getName() << " returns a type aligned above "
+                    << PROMISE_OFFSET << " bytes\n";
+        return false;
+    }
+    frame.promise = builder.CreateAlloca(frame.promise_type, nullptr, "promise");
+    frame.promise->setAlignment(promise_align);
+    frame.id = builder.CreateCall(
+        llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::coro_id),
+        {builder.getInt32(promise_align.value()), frame.promise,
+         llvm::ConstantPointerNull::get(ptr_type), llvm::ConstantPointerNull::get(ptr_type)},
+        "coro.id"
+    );
+    llvm::Value* need_alloc = builder.CreateCall(
+        llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::coro_alloc), {frame.id}, "coro.need.alloc"
+    );
+    llvm::BasicBlock* entry_block = builder.GetInsertBlock();
+    llvm::BasicBlock* alloc_block = llvm::BasicBlock::Create(context, "coro.alloc", function);
+    llvm::BasicBlock* begin_block = llvm::BasicBlock::Create(context, "coro.begin", function);
+    builder.CreateCondBr(need_alloc, alloc_block, begin_block);
+    
+    builder.SetInsertPoint(alloc_block);
+    llvm::Value* size = builder.CreateCall(
+        llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::coro_size, {builder.getInt64Ty()}), {}, "coro.size"
+    );
+    llvm::FunctionCallee malloc_function = module->getOrInsertFunction(
+        "malloc", llvm::FunctionType::get(ptr_type, {builder.getInt64Ty()}, false)
+    );
+    llvm::Value* memory = builder.CreateCall(malloc_function, {size}, "coro.mem");
+    builder.CreateBr(begin_block);
+    
+    builder.SetInsertPoint(begin_block);
+    llvm::PHINode* frame_memory = builder.CreatePHI(ptr_type, 2, "coro.frame.mem");
+    frame_memory->addIncoming(llvm::ConstantPointerNull::get(ptr_type), entry_block);
+    frame_memory->addIncoming(memory, alloc_block);
+    frame.handle = builder.CreateCall(
+        llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::coro_begin), {frame.id, frame_memory}, "coro.handle"
+    );
+    builder.CreateStore(llvm::ConstantAggregateZero::get(frame.promise_type), frame.promise);
+    
+    frame.final_block = llvm::BasicBlock::Create(context, "coro.final");
+    frame.cleanup_block = llvm::BasicBlock::Create(context, "coro.cleanup");
+    frame.suspend_block = llvm::BasicBlock::Create(context, "coro.suspend");
+    emitSuspend(ctx, frame, "coro.body");
+    return true;
+}
+
+// Final suspend (the resumer sees the coroutine done), frame cleanup and the
+// return to whoever resumed or created the coroutine
+static void emitAsyncEpilogue(CodeGenContext& ctx, llvm::Function* function, AsyncFrame& frame) {
+    llvm::IRBuilder<>& builder = ctx.getBuilder();
+    llvm::Module* module = ctx.getModule();
+    llvm::LLVMContext& context = ctx.getContext();
+    llvm::PointerType* ptr_type = llvm::PointerType::get(context, 0);
+    
+    frame.final_block->insertInto(function);
+    builder.SetInsertPoint(frame.final_block);
+    llvm::Value* state = builder.CreateCall(
+        llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::coro_suspend),
+        {llvm::ConstantTokenNone::get(context), builder.getTrue()}
+    );
+    llvm::BasicBlock* resumed_block = llvm::BasicBlock::Create(context, "coro.resumed.after.final", function);
+    llvm::SwitchInst* dispatch = builder.CreateSwitch(state, frame.suspend_block, 2);
+    dispatch->addCase(builder.getInt8(0), resumed_block);
+    dispatch->addCase(builder.getInt8(1), frame.cleanup_block);
+    builder.SetInsertPoint(resumed_block);
+    builder.CreateUnreachable();
+    
+    frame.cleanup_block->insertInto(function);
+    builder.SetInsertPoint(frame.cleanup_block);
+    llvm::Value* memory = builder.CreateCall(
+        llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::coro_free), {frame.id, frame.handle}, "coro.mem"
+    );
+    llvm::FunctionCallee free_function = module->getOrInsertFunction(
+        "free", llvm::FunctionType::get(builder.getVoidTy(), {ptr_type}, false)
+    );
+    builder.CreateCall(free_function, {memory});  // Null when the allocation was elided
+    builder.CreateBr(frame.suspend_block);
+    
+    frame.suspend_block->insertInto(function);
+    builder.SetInsertPoint(frame.suspend_block);
+    builder.CreateCall(
+        llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::coro_end),
+        {frame.handle, builder.getFalse(), llvm::ConstantTokenNone::get(context)}
+    );
+    builder.CreateRet(frame.handle);
+}
+
 llvm::Value* FunctionDecl::codegen(CodeGenContext& ctx) {
     // Prepare parameter types
     std::vector<llvm::Type*> param_types;
+    FunctionSignature signature{{}, return_type};
     for (const auto& param : params) {
+        if (param.first.kind == TypeKind::ARENA) {
+            ctx.error() << "pass arena " << param.second << " as *arena\n";
+            return nullptr;
+        }
+        if (param.first.kind == TypeKind::POOL) {
+            ctx.error() << "pool parameter " << param.second << ": pools are used by their global name\n";
+            return nullptr;
+        }
+        if (param.first.kind == TypeKind::TASK) {
+            ctx.error() << "task parameter " << param.second << ": join a task in the function that spawned it\n";
+            return nullptr;
+        }
         param_types.push_back(ctx.getLLVMType(param.first));
+        signature.params.push_back(param.first);
+    }
+    ctx.addFunctionSignature(name, signature);
+    
+    // Tasks are freed by the spawning function's sync, so handles cannot leave it
+    if (return_type.kind == TypeKind::TASK) {
+        ctx.error() << "fn " << name << " cannot return a task handle (join it first)\n";
+        return nullptr;
     }
     
+    // An async fn returns the handle of its suspended coroutine frame
     llvm::FunctionType* func_type = llvm::FunctionType::get(
-        ctx.getLLVMType(return_type), param_types, false
+        is_async ? llvm::PointerType::get(ctx.getContext(), 0) : ctx.getLLVMType(return_type), param_types, false
     );
+    if (is_async && name == "main") {
+        ctx.error() << "main cannot be async (call block_on from it)\n";
+        return nullptr;
+    }
     
     // Set linkage type: export uses ExternalLinkage, otherwise InternalLinkage
     llvm::GlobalValue::LinkageTypes linkage = is_export ? 
@@ -70,25 +395,48 @@ llvm::Value* FunctionDecl::codegen(CodeGenContext& ctx) {
         func_type, linkage, name, ctx.getModule()
     );
     
+    // Patchable entry/exit sleds, enabled at run time by runtime/olang_xray.c
+    if (ctx.getXRayThreshold() > 0) {
+        function->addFnAttr("xray-instruction-threshold", std::to_string(ctx.getXRayThreshold()));
+        ctx.addRuntimeInit("__olang_xray_init");
+    }
+    
     // Create basic block
     llvm::BasicBlock* entry_block = llvm::BasicBlock::Create(
         ctx.getContext(), "entry", function
     );
     ctx.getBuilder().SetInsertPoint(entry_block);
     
+    // async fn: CoroSplit turns the body into a resumable state machine
+    AsyncFrame async_frame;
+    if (is_async) {
+        function->setPresplitCoroutine();
+        if (!emitAsyncPrologue(ctx, function, return_type, async_frame)) {
+            return nullptr;
+        }
+        ctx.addAsyncFunction(name, AsyncFunction{return_type, async_frame.promise_type});
+        ctx.setAsyncFrame(&async_frame);
+    }
+    
     // Enter new scope
     ctx.enterScope();
+    size_t cleanup_depth = ctx.getCleanupDepth();
     
     // Create alloca for parameters and save SSA values
     auto arg_iter = function->arg_begin();
     for (const auto& param : params) {
-        llvm::AllocaInst* alloca = ctx.createAlloca(param.second, ctx.getLLVMType(param.first));
+        llvm::AllocaInst* alloca = ctx.createAlloca(param.second, param.first);
         ctx.getBuilder().CreateStore(&*arg_iter, alloca);
         // Also save parameter SSA value (for struct member access)
         ctx.setValue(param.second, &*arg_iter);
         arg_iter++;
     }
     
+    // Entry instrumentation (registers its exit half as a cleanup)
+    if (ctx.getInstrumentMode() != InstrumentMode::NONE) {
+        ctx.instrumentFunctionEntry(name);
+    }
+    
     // Generate function body
     for (auto& stmt : body) {
         stmt->codegen(ctx);
@@ -98,7 +446,11 @@ llvm::Value* FunctionDecl::codegen(CodeGenContext& ctx) {
     llvm::BasicBlock* current_bb = ctx.getBuilder().GetInsertBlock();
     if (!current_bb->getTerminator()) {
         // Add default return if function has no return statement
-        if (return_type.kind == TypeKind::VOID) {
+        if (is_async) {
+            ctx.emitCleanups();
+            ctx.getBuilder().CreateBr(async_frame.final_block);
+        } else if (return_type.kind == TypeKind::VOID) {
+            ctx.emitCleanups();
             ctx.getBuilder().CreateRetVoid();
         } else {
             // For non-void function, return default value if no return statement
@@ -114,28 +466,58 @@ llvm::Value* FunctionDecl::codegen(CodeGenContext& ctx) {
                 default: break;
             }
             if (default_value) {
+                ctx.emitCleanups();
                 ctx.getBuilder().CreateRet(default_value);
             }
         }
     }
     
     // Exit scope
+    ctx.popCleanups(cleanup_depth);
     ctx.exitScope();
     
+    if (is_async) {
+        emitAsyncEpilogue(ctx, function, async_frame);
+        ctx.setAsyncFrame(nullptr);
+    }
+    
     return function;
 }
 
 llvm::Value* ExternDecl::codegen(CodeGenContext& ctx) {
     // Prepare parameter types
     std::vector<llvm::Type*> param_types;
+    FunctionSignature signature{{}, return_type};
     for (const auto& param : params) {
+        if (param.first.kind == TypeKind::TASK) {
+            ctx.error() << "extern fn " << name << " cannot take a task handle\n";
+            return nullptr;
+        }
         param_types.push_back(ctx.getLLVMType(param.first));
+        signature.params.push_back(param.first);
     }
+    if (return_type.kind == TypeKind::TASK) {
+        ctx.error() << "extern fn " << name << " cannot return a task handle\n";
+        return nullptr;
+    }
+    ctx.addFunctionSignature(name, signature);
     
     llvm::FunctionType* func_type = llvm::FunctionType::get(
         ctx.getLLVMType(return_type), param_types, false
     );
     
+    // extern async fn f(args) -> T is void f(waiter, args) in C: it arranges for
+    // __olang_async_complete(waiter, result) to be called when the result is ready
+    if (is_async) {
+        if (return_type.kind != TypeKind::VOID && !ctx.getLLVMType(return_type)->isIntegerTy()) {
+            ctx.error() << "extern async fn " << name << " must return an integer or nothing\n";
+            return nullptr;
+        }
+        param_types.insert(param_types.begin(), llvm::PointerType::get(ctx.getContext(), 0));
+        func_type = llvm::FunctionType::get(llvm::Type::getVoidTy(ctx.getContext()), param_types, false);
+        ctx.addAsyncFunction(name, AsyncFunction{return_type, nullptr});
+    }
+    
     // Create external function declaration (declare only, no definition)
     llvm::Function* function = llvm::Function::Create(
         func_type, llvm::Function::ExternalLinkage, name, ctx.getModule()
@@ -144,33 +526,363 @@ llvm::Value* ExternDecl::codegen(CodeGenContext& ctx) {
     return function;
 }
 
-llvm::Value* LetStmt::codegen(CodeGenContext& ctx) {
+// pool<T> layout shared with runtime/olang_pool.c: words in struct
+// pool_depot, and the free-list length at which pool_free hands a batch of
+// POOL_FLUSH / 2 objects to the depot (POOL_FLUSH there)
+static const int64_t POOL_DEPOT_WORDS = 4;
+static const int64_t POOL_FLUSH = 256;
+
+// #[hugepage] globals: section madvised by __olang_hugepage_init
+// (runtime/olang_huge.c) and alignment of a 2 MiB huge page
+static const char* const HUGEPAGE_SECTION = "olang_hugepage";
+static const uint64_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+// Literals and operators on them: what a global initializer may contain (it is
+// generated outside any function)
+static bool isConstantInitializer(ASTNode* expr) {
+    if (dynamic_cast<IntLiteral*>(expr) || dynamic_cast<FloatLiteral*>(expr) || dynamic_cast<BoolLiteral*>(expr) ||
+        dynamic_cast<StringLiteral*>(expr)) {
+        return true;
+    }
+    if (auto unary = dynamic_cast<UnaryExpr*>(expr)) {
+        return (unary->op == UnaryExpr::NEG || unary->op == UnaryExpr::NOT) &&
+               isConstantInitializer(unary->operand.get());
+    }
+    if (auto binary = dynamic_cast<BinaryExpr*>(expr)) {
+        return isConstantInitializer(binary->left.get()) && isConstantInitializer(binary->right.get());
+    }
+    return false;
+}
+
+llvm::Value* GlobalVarDecl::codegen(CodeGenContext& ctx) {
+    if (type.kind == TypeKind::ARENA) {
+        ctx.error() << "arena " << name << " must be declared by an arena block\n";
+        return nullptr;
+    }
+    if (type.kind == TypeKind::TASK) {
+        ctx.error() << "task " << name << " must be a local variable of the spawning function\n";
+        return nullptr;
+    }
     llvm::Type* llvm_type = ctx.getLLVMType(type);
-    llvm::AllocaInst* alloca = ctx.createAlloca(name, llvm_type);
     
-    // For arrays and structs, always use zero initialization
+    // Arrays and structs are zero-initialized, like let
+    llvm::Constant* initializer = llvm::Constant::getNullValue(llvm_type);
+    if (!llvm_type->isStructTy() && !llvm_type->isArrayTy()) {
+        if (!value || !isConstantInitializer(value.get())) {
+            ctx.error() << "global " << name << " needs a constant initializer\n";
+            return nullptr;
+        }
+        llvm::Value* init_value = value->codegen(ctx);
+        if (init_value) {
+            init_value = ctx.convertValue(init_value, llvm_type);
+        }
+        initializer = llvm::dyn_cast_or_null<llvm::Constant>(init_value);
+        if (!initializer) {
+            ctx.error() << "global " << name << " needs a constant initializer\n";
+            return nullptr;
+        }
+    }
+    
+    bool soa = findAttribute(attributes, "soa") != nullptr;
+    if (soa) {
+        llvm_type = ctx.getSoAType(type);
+        if (!llvm_type) {
+            ctx.error() << "#[soa] on global " << name << " needs an array of structs\n";
+            return nullptr;
+        }
+        initializer = llvm::Constant::getNullValue(llvm_type);
+    }
+    
+    // Globals are internal to the object and olang-link produces executables,
+    // so thread_local globals can always use the local-exec TLS model. A
+    // pool's free list is always per thread.
+    bool per_thread = is_thread_local || type.kind == TypeKind::POOL;
+    llvm::GlobalVariable* global = new llvm::GlobalVariable(
+        *ctx.getModule(), llvm_type, false, llvm::GlobalValue::InternalLinkage, initializer, name, nullptr,
+        per_thread ? llvm::GlobalValue::LocalExecTLSModel : llvm::GlobalValue::NotThreadLocal
+    );
+    llvm::Align align = ctx.getTypeAlign(type);
+    if (uint64_t min_align = getAlignAttribute(ctx, attributes, "global " + name)) {
+        align = std::max(align, llvm::Align(min_align));
+    }
+    if (findAttribute(attributes, "hugepage")) {
+        if (type.kind != TypeKind::ARRAY || is_thread_local) {
+            ctx.error() << "#[hugepage] on global " << name << " needs a shared array\n";
+            return nullptr;
+        }
+        uint64_t size = ctx.getModule()->getDataLayout().getTypeAllocSize(llvm_type);
+        if (size < HUGE_PAGE_SIZE) {
+            llvm::errs() << "Warning: #[hugepage] global " << name << " (" << size
+                         << " bytes) is smaller than a huge page\n";
+        }
+        global->setSection(HUGEPAGE_SECTION);
+        align = std::max(align, llvm::Align(HUGE_PAGE_SIZE));
+        ctx.addRuntimeInit("__olang_hugepage_init");
+    }
+    global->setAlignment(align);
+    ctx.addGlobalVariable(name, global, type, soa);
+    if (type.kind == TypeKind::POOL) {
+        // Shared by all threads: batches of free objects handed between them
+        llvm::Type* depot_type = llvm::ArrayType::get(llvm::Type::getInt64Ty(ctx.getContext()), POOL_DEPOT_WORDS);
+        llvm::GlobalVariable* depot = new llvm::GlobalVariable(
+            *ctx.getModule(), depot_type, false, llvm::GlobalValue::InternalLinkage,
+            llvm::Constant::getNullValue(depot_type), name + ".depot"
+        );
+        depot->setAlignment(llvm::Align(8));
+    }
+    return global;
+}
+
+// Source type of an lvalue (variable, arr[i], s[i], obj.field, *p), without generating code
+static bool getLValueType(CodeGenContext& ctx, ASTNode* expr, Type& type) {
+    if (auto ident = dynamic_cast<Identifier*>(expr)) {
+        Variable var = ctx.getVariable(ident->name);
+        if (!var) {
+            return false;
+        }
+        type = var.olang_type;
+        return true;
+    }
+    if (auto array_access = dynamic_cast<ArrayAccess*>(expr)) {
+        Type array_type;
+        if (!getLValueType(ctx, array_access->array.get(), array_type) ||
+            (array_type.kind != TypeKind::ARRAY && array_type.kind != TypeKind::SLICE)) {
+            return false;
+        }
+        type = *array_type.element_type;
+        return true;
+    }
+    if (auto member_access = dynamic_cast<MemberAccess*>(expr)) {
+        Type struct_type;
+        const StructInfo* info = getLValueType(ctx, member_access->object.get(), struct_type) &&
+                                 struct_type.kind == TypeKind::STRUCT ? ctx.getStructInfo(struct_type.name) : nullptr;
+        if (!info) {
+            return false;
+        }
+        for (const auto& field : info->fields) {
+            if (field.second == member_access->member) {
+                type = field.first;
+                return true;
+            }
+        }
+        return false;
+    }
+    if (auto unary = dynamic_cast<UnaryExpr*>(expr)) {
+        Type pointer_type;
+        if (unary->op != UnaryExpr::DEREF || !getLValueType(ctx, unary->operand.get(), pointer_type) ||
+            pointer_type.kind != TypeKind::POINTER) {
+            return false;
+        }
+        type = *pointer_type.element_type;
+        return true;
+    }
+    return false;
+}
+
+// Source type of a pointer expression where the compiler knows it: a pointer
+// lvalue, &x, or a call to a function or extern returning a pointer
+static bool getPointerSourceType(CodeGenContext& ctx, ASTNode* expr, Type& type) {
+    if (auto unary = dynamic_cast<UnaryExpr*>(expr)) {
+        Type operand_type;
+        if (unary->op != UnaryExpr::ADDR || !getLValueType(ctx, unary->operand.get(), operand_type)) {
+            return false;
+        }
+        type = Type(TypeKind::POINTER, std::make_shared<Type>(operand_type));
+        return true;
+    }
+    if (auto call = dynamic_cast<CallExpr*>(expr)) {
+        const FunctionSignature* signature = ctx.getFunctionSignature(call->function_name);
+        if (!signature) {
+            return false;
+        }
+        type = signature->result;
+    } else if (!getLValueType(ctx, expr, type)) {
+        return false;
+    }
+    return type.kind == TypeKind::POINTER;
+}
+
+// as_slice(arr) or as_slice(p, n); type receives slice T for the array's or the pointer's T
+static llvm::Value* emitAsSlice(CodeGenContext& ctx, std::vector<std::unique_ptr<Expr>>& args, Type& type) {
+    llvm::IRBuilder<>& builder = ctx.getBuilder();
+    Type source_type;
+    llvm::Value* data = nullptr;
+    llvm::Value* length = nullptr;
+    if (args.size() == 1) {
+        data = ctx.emitAddress(args[0].get(), source_type);
+        if (!data || source_type.kind != TypeKind::ARRAY) {
+            ctx.error() << "as_slice(arr) needs an array variable (not #[soa])\n";
+            return nullptr;
+        }
+        length = builder.getInt64(source_type.array_size);
+    } else if (args.size() == 2) {
+        if (!getPointerSourceType(ctx, args[0].get(), source_type)) {
+            ctx.error() << "as_slice(p, n) needs a typed pointer: a pointer variable, &x or a call returning one\n";
+            return nullptr;
+        }
+        data = args[0]->codegen(ctx);
+        length = args[1]->codegen(ctx);
+        if (!data || !length || !length->getType()->isIntegerTy()) {
+            ctx.error() << "as_slice(p, n) needs a pointer and an element count\n";
+            return nullptr;
+        }
+        length = ctx.convertIndex(length);
+    } else {
+        ctx.error() << "as_slice takes an array, or a pointer and a length\n";
+        return nullptr;
+    }
+    type = Type(TypeKind::SLICE, source_type.element_type);
+    llvm::Type* slice_type = ctx.getLLVMType(type);
+    llvm::Value* slice = builder.CreateInsertValue(llvm::PoisonValue::get(slice_type), data, 0);
+    return builder.CreateInsertValue(slice, length, 1, "slice");
+}
+
+// Value of a slice expression (as_slice(...), a slice lvalue or a call returning
+// a slice) with its source type; every slice lowers to the same { ptr, i64 },
+// so the element type is only known here. nullptr for other expressions.
+static llvm::Value* emitSliceValue(CodeGenContext& ctx, ASTNode* expr, Type& type) {
+    if (auto call = dynamic_cast<CallExpr*>(expr)) {
+        if (call->function_name == "as_slice" && !ctx.getModule()->getFunction("as_slice")) {
+            return emitAsSlice(ctx, call->args, type);
+        }
+        const FunctionSignature* signature = ctx.getFunctionSignature(call->function_name);
+        if (!signature || signature->result.kind != TypeKind::SLICE) {
+            return nullptr;
+        }
+        type = signature->result;
+        return call->codegen(ctx);
+    }
+    Type lvalue_type;
+    if (!getLValueType(ctx, expr, lvalue_type) || lvalue_type.kind != TypeKind::SLICE) {
+        return nullptr;
+    }
+    llvm::Value* ptr = ctx.emitAddress(expr, type);
+    return ptr ? ctx.getBuilder().CreateLoad(ctx.getLLVMType(type), ptr, "slice") : nullptr;
+}
+
+// Slice value for a destination of type expected (a let, assignment, argument or return)
+static llvm::Value* emitSliceFor(CodeGenContext& ctx, ASTNode* expr, const Type& expected, const std::string& what) {
+    Type type;
+    llvm::Value* slice = emitSliceValue(ctx, expr, type);
+    if (!slice) {
+        ctx.error() << what << " needs as_slice(...), a slice variable or a call returning a slice\n";
+        return nullptr;
+    }
+    if (type != expected) {
+        ctx.error() << what << " is a " << typeName(expected) << ", not a " << typeName(type) << "\n";
+        return nullptr;
+    }
+    return slice;
+}
+
+// Argument i of a call to function_name; slice parameters check the element type
+static llvm::Value* emitArgument(CodeGenContext& ctx, const std::string& function_name, size_t i,
+                                 ASTNode* expr, llvm::Type* param_type) {
+    const FunctionSignature* signature = ctx.getFunctionSignature(function_name);
+    if (signature && i < signature->params.size() && signature->params[i].kind == TypeKind::SLICE) {
+        return emitSliceFor(ctx, expr, signature->params[i],
+                            "argument " + std::to_string(i + 1) + " of " + function_name);
+    }
+    llvm::Value* value = expr->codegen(ctx);
+    return value && param_type ? ctx.convertValue(value, param_type) : value;
+}
+
+llvm::Value* LetStmt::codegen(CodeGenContext& ctx) {
+    if (type.kind == TypeKind::ARENA) {
+        ctx.error() << "arena " << name << " must be declared by an arena block: arena " << name << " { ... }\n";
+        return nullptr;
+    }
+    if (type.kind == TypeKind::POOL) {
+        ctx.error() << "pool " << name << " must be a global\n";
+        return nullptr;
+    }
+    if (findAttribute(attributes, "hugepage")) {
+        ctx.error() << "#[hugepage] on " << name << " needs a global array (use olang_huge_alloc for heap memory)\n";
+        return nullptr;
+    }
+    bool soa = findAttribute(attributes, "soa") != nullptr;
+    if (soa && !ctx.getSoAType(type)) {
+        ctx.error() << "#[soa] on " << name << " needs an array of structs\n";
+        return nullptr;
+    }
+    llvm::AllocaInst* alloca = ctx.createAlloca(name, type, getAlignAttribute(ctx, attributes, name), soa);
+    llvm::Type* llvm_type = alloca->getAllocatedType();
+    if (type.kind == TypeKind::TASK) {
+        ctx.addTaskHandle(alloca);
+    }
+    
+    // For arrays and structs (and channels), always use zero initialization
     // (initializer expression is just a placeholder in Olang syntax)
-    if (llvm_type->isStructTy() || llvm_type->isArrayTy()) {
+    if ((llvm_type->isStructTy() || llvm_type->isArrayTy()) && type.kind != TypeKind::SLICE) {
         llvm::Value* zero_init = llvm::ConstantAggregateZero::get(llvm_type);
         ctx.getBuilder().CreateStore(zero_init, alloca);
         return alloca;
     }
     
+    if (type.kind == TypeKind::SLICE) {
+        llvm::Value* slice = emitSliceFor(ctx, this->value.get(), type, "slice " + name);
+        if (!slice) {
+            return nullptr;
+        }
+        ctx.getBuilder().CreateStore(slice, alloca);
+        return alloca;
+    }
+    
     // For scalar types, evaluate and store the value
     llvm::Value* value = this->value->codegen(ctx);
     if (!value) {
         return nullptr; // Error
     }
     
-    ctx.getBuilder().CreateStore(value, alloca);
+    ctx.getBuilder().CreateStore(ctx.convertValue(value, llvm_type), alloca);
     return alloca;
 }
 
 llvm::Value* ReturnStmt::codegen(CodeGenContext& ctx) {
+    if (ctx.isInOutlinedRegion()) {
+        ctx.error() << "return inside a parallel region\n";
+        return nullptr;
+    }
+    
+    // A slice result must have the declared element type
+    llvm::Function* function = ctx.getBuilder().GetInsertBlock()->getParent();
+    std::string function_name = function->getName().str();
+    const FunctionSignature* signature = ctx.getFunctionSignature(function_name);
+    auto emitReturnValue = [&]() -> llvm::Value* {
+        if (signature && signature->result.kind == TypeKind::SLICE) {
+            return emitSliceFor(ctx, expr.get(), signature->result, "return value of " + function_name);
+        }
+        return expr->codegen(ctx);
+    };
+    
+    // async fn: the result goes to the promise, where the awaiting side reads it
+    if (AsyncFrame* frame = ctx.getAsyncFrame()) {
+        if (expr) {
+            llvm::Value* return_value = emitReturnValue();
+            if (!return_value) {
+                return nullptr;
+            }
+            if (frame->promise_type->getNumElements() > 3) {
+                llvm::Value* result_ptr = ctx.getBuilder().CreateStructGEP(frame->promise_type, frame->promise, 3);
+                ctx.getBuilder().CreateStore(
+                    ctx.convertValue(return_value, frame->promise_type->getElementType(3)), result_ptr
+                );
+            }
+        }
+        ctx.emitCleanups();
+        return ctx.getBuilder().CreateBr(frame->final_block);
+    }
+    
     if (expr) {
-        llvm::Value* return_value = expr->codegen(ctx);
+        llvm::Value* return_value = emitReturnValue();
+        if (!return_value) {
+            return nullptr;
+        }
+        return_value = ctx.convertValue(return_value, function->getReturnType());
+        ctx.emitCleanups();
         return ctx.getBuilder().CreateRet(return_value);
     } else {
+        ctx.emitCleanups();
         return ctx.getBuilder().CreateRetVoid();
     }
 }
@@ -269,38 +981,663 @@ llvm::Value* WhileStmt::codegen(CodeGenContext& ctx) {
     return nullptr;
 }
 
-// Expression code generation
-llvm::Value* IntLiteral::codegen(CodeGenContext& ctx) {
-    // Default to i32 type (most common)
-    return llvm::ConstantInt::get(ctx.getContext(), llvm::APInt(32, value, true));
-}
-
-llvm::Value* FloatLiteral::codegen(CodeGenContext& ctx) {
-    return llvm::ConstantFP::get(ctx.getContext(), llvm::APFloat(value));
-}
-
-llvm::Value* StringLiteral::codegen(CodeGenContext& ctx) {
-    return ctx.getBuilder().CreateGlobalStringPtr(value);
-}
-
-llvm::Value* BoolLiteral::codegen(CodeGenContext& ctx) {
-    return llvm::ConstantInt::getBool(ctx.getContext(), value);
+// Counted loop for (var = lo; var < hi; var += step) { emit_body(var) } in the
+// current function (var > hi for a descending loop, whose step is negative).
+// It is emitted rotated, the shape LLVM's loop passes expect: a guard, then a
+// body-first loop whose SSA induction variable steps nsw and whose exit tests
+// an explicit trip count. var is a copy of the induction variable, so the body
+// cannot change the trip count. A runtime step traps when 0, and a negative
+// one (against the ascending direction) runs no iterations.
+static void emitRangeLoop(CodeGenContext& ctx, const std::string& var, llvm::Value* lo, llvm::Value* hi,
+                          llvm::Value* step, bool descending,
+                          const std::function<void(llvm::Value* index)>& emit_body) {
+    llvm::IRBuilder<>& builder = ctx.getBuilder();
+    llvm::Function* function = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock* preheader_block = llvm::BasicBlock::Create(ctx.getContext(), "for_preheader", function);
+    llvm::BasicBlock* body_block = llvm::BasicBlock::Create(ctx.getContext(), "for_body", function);
+    llvm::BasicBlock* latch_block = llvm::BasicBlock::Create(ctx.getContext(), "for_latch", function);
+    llvm::BasicBlock* end_block = llvm::BasicBlock::Create(ctx.getContext(), "for_end", function);
+    
+    auto* constant_step = llvm::dyn_cast<llvm::ConstantInt>(step);
+    if (!constant_step) {
+        llvm::BasicBlock* trap_block = llvm::BasicBlock::Create(ctx.getContext(), "for_step_zero", function);
+        llvm::BasicBlock* guard_block = llvm::BasicBlock::Create(ctx.getContext(), "for_guard", function);
+        builder.CreateCondBr(builder.CreateICmpEQ(step, builder.getInt64(0), "for.step.zero"), trap_block, guard_block);
+        builder.SetInsertPoint(trap_block);
+        builder.CreateCall(llvm::Intrinsic::getDeclaration(ctx.getModule(), llvm::Intrinsic::trap));
+        builder.CreateUnreachable();
+        builder.SetInsertPoint(guard_block);
+    }
+    llvm::Value* enter = descending ? builder.CreateICmpSGT(lo, hi, "for.enter") : builder.CreateICmpSLT(lo, hi, "for.enter");
+    if (!constant_step) {
+        enter = builder.CreateAnd(enter, builder.CreateICmpSGT(step, builder.getInt64(0)), "for.enter");
+    }
+    builder.CreateCondBr(enter, preheader_block, end_block);
+    
+    // trip = (distance - 1) / |step| + 1; distance is exact as unsigned once the guard holds
+    builder.SetInsertPoint(preheader_block);
+    llvm::Value* distance = descending ? builder.CreateSub(lo, hi, "for.distance") : builder.CreateSub(hi, lo, "for.distance");
+    llvm::Value* trip = distance;
+    if (!constant_step || !constant_step->getValue().abs().isOne()) {
+        llvm::Value* magnitude = descending ? builder.CreateNeg(step) : step;
+        trip = builder.CreateAdd(
+            builder.CreateUDiv(builder.CreateSub(distance, builder.getInt64(1)), magnitude), builder.getInt64(1)
+        );
+    }
+    trip->setName("for.trip");
+    builder.CreateBr(body_block);
+    
+    builder.SetInsertPoint(body_block);
+    llvm::PHINode* index = builder.CreatePHI(builder.getInt64Ty(), 2, var + ".iv");
+    llvm::PHINode* count = builder.CreatePHI(builder.getInt64Ty(), 2, "for.count");
+    index->addIncoming(lo, preheader_block);
+    count->addIncoming(builder.getInt64(0), preheader_block);
+    ctx.enterScope();
+    llvm::AllocaInst* copy = ctx.createAlloca(var, Type(TypeKind::I64));
+    builder.CreateStore(index, copy);
+    emit_body(index);
+    ctx.exitScope();
+    if (!builder.GetInsertBlock()->getTerminator()) {
+        builder.CreateBr(latch_block);
+    }
+    
+    if (latch_block->hasNPredecessorsOrMore(1)) {
+        // The last increment may overflow: its result is then unused, so nsw holds where it matters
+        builder.SetInsertPoint(latch_block);
+        llvm::Value* next_index = builder.CreateNSWAdd(index, step, var + ".next");
+        // The count is unsigned and stops at trip (up to 2^64 - 1 iterations), so it carries no nsw
+        llvm::Value* next_count = builder.CreateAdd(count, builder.getInt64(1), "for.count.next", true);
+        builder.CreateCondBr(builder.CreateICmpEQ(next_count, trip, "for.done"), end_block, body_block);
+        index->addIncoming(next_index, latch_block);
+        count->addIncoming(next_count, latch_block);
+    } else {
+        latch_block->eraseFromParent();
+    }
+    
+    builder.SetInsertPoint(end_block);
 }
 
-llvm::Value* Identifier::codegen(CodeGenContext& ctx) {
-    llvm::AllocaInst* alloca = ctx.getAlloca(name);
-    if (alloca) {
-        return ctx.getBuilder().CreateLoad(alloca->getAllocatedType(), alloca, name);
-    }
-    return nullptr;
+static void emitRangeLoop(CodeGenContext& ctx, const std::string& var, llvm::Value* lo, llvm::Value* hi,
+                          const std::function<void(llvm::Value* index)>& emit_body) {
+    emitRangeLoop(ctx, var, lo, hi, ctx.getBuilder().getInt64(1), false, emit_body);
 }
 
-llvm::Value* BinaryExpr::codegen(CodeGenContext& ctx) {
-    llvm::Value* left_value = left->codegen(ctx);
-    llvm::Value* right_value = right->codegen(ctx);
+llvm::Value* ForStmt::codegen(CodeGenContext& ctx) {
+    llvm::IRBuilder<>& builder = ctx.getBuilder();
     
-    if (!left_value || !right_value) {
-        return nullptr;
+    if (end) {
+        // Bounds and step are evaluated once, before the first iteration
+        llvm::Value* start_value = iterable->codegen(ctx);
+        llvm::Value* end_value = end->codegen(ctx);
+        llvm::Value* step_value = step ? step->codegen(ctx) : builder.getInt64(1);
+        if (!start_value || !end_value || !step_value) {
+            return nullptr;
+        }
+        start_value = ctx.convertIndex(start_value);
+        end_value = ctx.convertIndex(end_value);
+        step_value = ctx.convertIndex(step_value);
+        
+        // Only a constant step may count down; a runtime step of 0 traps and a
+        // negative one runs no iterations
+        bool descending = false;
+        if (auto* constant_step = llvm::dyn_cast<llvm::ConstantInt>(step_value)) {
+            if (constant_step->isZero()) {
+                ctx.error() << "for " << var << " has a step of 0\n";
+                return nullptr;
+            }
+            descending = constant_step->isNegative();
+        }
+        emitRangeLoop(ctx, var, start_value, end_value, step_value, descending, [&](llvm::Value*) {
+            for (auto& stmt : body) {
+                stmt->codegen(ctx);
+            }
+        });
+        return nullptr;
+    }
+    
+    // The data pointer and length are read once, before the first iteration
+    Type iterable_type;
+    llvm::Value* iterable_ptr = ctx.emitAddress(iterable.get(), iterable_type);
+    llvm::Value* data = nullptr;
+    llvm::Value* length = nullptr;
+    if (iterable_ptr && iterable_type.kind == TypeKind::ARRAY) {
+        data = iterable_ptr;
+        length = builder.getInt64(iterable_type.array_size);
+    } else if (iterable_ptr && iterable_type.kind == TypeKind::SLICE) {
+        llvm::Value* slice = builder.CreateLoad(ctx.getLLVMType(iterable_type), iterable_ptr, "slice");
+        data = builder.CreateExtractValue(slice, 0, "slice.data");
+        length = builder.CreateExtractValue(slice, 1, "slice.len");
+    } else {
+        ctx.error() << "for " << var << " in needs a slice or array variable (not #[soa])\n";
+        return nullptr;
+    }
+    
+    // Indices stay within the length, so element accesses need no bounds checks
+    Type element_type = *iterable_type.element_type;
+    llvm::Type* llvm_element_type = ctx.getLLVMType(element_type);
+    llvm::Align element_align = ctx.getTypeAlign(element_type);
+    emitRangeLoop(ctx, "for.index", builder.getInt64(0), length, [&](llvm::Value* index) {
+        llvm::Value* element_ptr = builder.CreateInBoundsGEP(llvm_element_type, data, index, "for.elem");
+        llvm::AllocaInst* element = ctx.createAlloca(var, element_type);
+        builder.CreateAlignedStore(builder.CreateAlignedLoad(llvm_element_type, element_ptr, element_align, var),
+                                   element, element->getAlign());
+        for (auto& stmt : body) {
+            stmt->codegen(ctx);
+        }
+    });
+    return nullptr;
+}
+
+// Reduce loops always run as this many chunks, whatever the thread count, so
+// every chunk sums the same iterations and the combine tree has a fixed shape
+static const int64_t REDUCE_CHUNKS = 256;
+
+static llvm::Value* getReduceIdentity(ParallelForStmt::ReduceOp op, llvm::Type* type) {
+    bool is_float = type->isFloatingPointTy();
+    switch (op) {
+    case ParallelForStmt::MUL:
+        return is_float ? llvm::ConstantFP::get(type, 1.0) : llvm::ConstantInt::get(type, 1);
+    case ParallelForStmt::MIN:
+        return is_float ? llvm::ConstantFP::getInfinity(type, false)
+                        : llvm::ConstantInt::get(type, llvm::APInt::getSignedMaxValue(type->getIntegerBitWidth()));
+    case ParallelForStmt::MAX:
+        return is_float ? llvm::ConstantFP::getInfinity(type, true)
+                        : llvm::ConstantInt::get(type, llvm::APInt::getSignedMinValue(type->getIntegerBitWidth()));
+    default:
+        return llvm::Constant::getNullValue(type);
+    }
+}
+
+static llvm::Value* emitReduceCombine(CodeGenContext& ctx, ParallelForStmt::ReduceOp op, llvm::Function* function,
+                                      llvm::Value* a, llvm::Value* b) {
+    llvm::IRBuilder<>& builder = ctx.getBuilder();
+    bool is_float = a->getType()->isFloatingPointTy();
+    switch (op) {
+    case ParallelForStmt::ADD:
+        return is_float ? builder.CreateFAdd(a, b) : builder.CreateAdd(a, b);
+    case ParallelForStmt::MUL:
+        return is_float ? builder.CreateFMul(a, b) : builder.CreateMul(a, b);
+    case ParallelForStmt::MIN:
+        return builder.CreateSelect(is_float ? builder.CreateFCmpOLT(b, a) : builder.CreateICmpSLT(b, a), b, a);
+    case ParallelForStmt::MAX:
+        return builder.CreateSelect(is_float ? builder.CreateFCmpOGT(b, a) : builder.CreateICmpSGT(b, a), b, a);
+    default:
+        return builder.CreateCall(function, {a, b});
+    }
+}
+
+// reduce(op: acc) over parallel for: chunk c of the range accumulates into a
+// private partials[c], then the partials are combined pairwise in a fixed tree
+static llvm::Value* emitParallelReduce(CodeGenContext& ctx, ParallelForStmt& stmt,
+                                       llvm::Value* start_value, llvm::Value* end_value) {
+    llvm::IRBuilder<>& builder = ctx.getBuilder();
+    llvm::Module* module = ctx.getModule();
+    llvm::Type* i64_type = builder.getInt64Ty();
+    llvm::Type* ptr_type = llvm::PointerType::get(ctx.getContext(), 0);
+    
+    Variable acc = ctx.getVariable(stmt.reduce_var);
+    if (!acc || acc.soa_record || acc.olang_type.kind == TypeKind::ATOMIC ||
+        !(acc.type->isIntegerTy() || acc.type->isFloatingPointTy())) {
+        ctx.error() << "reduce needs a scalar integer or float variable: " << stmt.reduce_var << "\n";
+        return nullptr;
+    }
+    llvm::Function* combine_function = nullptr;
+    if (stmt.reduce_op == ParallelForStmt::CUSTOM) {
+        combine_function = module->getFunction(stmt.reduce_function);
+        if (!combine_function ||
+            combine_function->getFunctionType() != llvm::FunctionType::get(acc.type, {acc.type, acc.type}, false)) {
+            ctx.error() << "reduce function must take two values of the reduced type and return one: "
+                        << stmt.reduce_function << "\n";
+            return nullptr;
+        }
+        if (!stmt.reduce_identity) {
+            ctx.error() << "reduce(" << stmt.reduce_function << ", identity: " << stmt.reduce_var
+                        << ") needs the function's identity\n";
+            return nullptr;
+        }
+    } else if (stmt.reduce_identity) {
+        ctx.error() << "reduce with a built-in operator takes no identity: " << stmt.reduce_var << "\n";
+        return nullptr;
+    }
+    // Every chunk starts from the identity; the initial value is folded in once, at the end
+    llvm::Value* identity_value = nullptr;
+    if (stmt.reduce_identity) {
+        identity_value = stmt.reduce_identity->codegen(ctx);
+        if (!identity_value) {
+            return nullptr;
+        }
+        identity_value = ctx.convertValue(identity_value, acc.type);
+    }
+    if (stmt.chunk) {
+        llvm::errs() << "Warning: schedule chunk size is ignored by reduce loops\n";
+    }
+    
+    // Hidden locals, captured by the outlined body like any other variable
+    ctx.enterScope();
+    Type partials_type(TypeKind::ARRAY, REDUCE_CHUNKS, std::make_shared<Type>(acc.olang_type));
+    llvm::AllocaInst* partials = ctx.createAlloca("reduce.partials", partials_type);
+    builder.CreateStore(start_value, ctx.createAlloca("reduce.start", Type(TypeKind::I64)));
+    if (identity_value) {
+        builder.CreateStore(identity_value, ctx.createAlloca("reduce.identity", acc.olang_type));
+    }
+    llvm::Value* range = builder.CreateSub(end_value, start_value);
+    range = builder.CreateSelect(builder.CreateICmpSGT(range, builder.getInt64(0)), range, builder.getInt64(0));
+    builder.CreateStore(range, ctx.createAlloca("reduce.range", Type(TypeKind::I64)));
+    llvm::Type* partials_llvm_type = partials->getAllocatedType();
+    
+    llvm::Value* env = nullptr;
+    llvm::Function* body_function = ctx.outlineRange("parallel_reduce", [&](llvm::Value* lo, llvm::Value* hi) {
+        llvm::Value* partials_ref = ctx.getVariable("reduce.partials").ptr;
+        llvm::Value* first = builder.CreateLoad(i64_type, ctx.getVariable("reduce.start").ptr, "first");
+        llvm::Value* total = builder.CreateLoad(i64_type, ctx.getVariable("reduce.range").ptr, "range");
+        llvm::Value* block = builder.CreateSDiv(total, builder.getInt64(REDUCE_CHUNKS));
+        llvm::Value* extra = builder.CreateSRem(total, builder.getInt64(REDUCE_CHUNKS));
+        llvm::Value* identity = combine_function
+            ? builder.CreateLoad(acc.type, ctx.getVariable("reduce.identity").ptr, "reduce.identity")
+            : getReduceIdentity(stmt.reduce_op, acc.type);
+        
+        emitRangeLoop(ctx, "reduce.chunk", lo, hi, [&](llvm::Value* chunk) {
+            // Same split as schedule(static): the first `extra` chunks get one more iteration
+            llvm::Value* chunk_start = builder.CreateAdd(
+                builder.CreateAdd(first, builder.CreateMul(chunk, block)),
+                builder.CreateSelect(builder.CreateICmpSLT(chunk, extra), chunk, extra));
+            llvm::Value* chunk_end = builder.CreateAdd(
+                builder.CreateAdd(chunk_start, block),
+                builder.CreateZExt(builder.CreateICmpSLT(chunk, extra), i64_type));
+            
+            llvm::AllocaInst* partial = ctx.createAlloca(stmt.reduce_var, acc.olang_type);
+            builder.CreateStore(identity, partial);
+            emitRangeLoop(ctx, stmt.var, chunk_start, chunk_end, [&](llvm::Value*) {
+                for (auto& body_stmt : stmt.body) {
+                    body_stmt->codegen(ctx);
+                }
+            });
+            llvm::Value* slot = builder.CreateInBoundsGEP(partials_llvm_type, partials_ref, {builder.getInt64(0), chunk});
+            builder.CreateStore(builder.CreateLoad(acc.type, partial), slot);
+        });
+    }, env);
+    
+    llvm::FunctionCallee parallel_for = module->getOrInsertFunction(
+        "__olang_parallel_for",
+        llvm::FunctionType::get(builder.getVoidTy(),
+                                {ptr_type, i64_type, i64_type, ptr_type, builder.getInt32Ty(), i64_type},
+                                false)
+    );
+    llvm::Value* schedule_chunk = builder.getInt64(stmt.schedule == ParallelForStmt::DYNAMIC ? 1 : 0);
+    builder.CreateCall(parallel_for, {body_function, builder.getInt64(0), builder.getInt64(REDUCE_CHUNKS), env,
+                                      builder.getInt32(stmt.schedule), schedule_chunk});
+    
+    // partials[i] = partials[i] op partials[i + stride] for stride = 1, 2, 4, ...
+    for (int64_t stride = 1; stride < REDUCE_CHUNKS; stride *= 2) {
+        emitRangeLoop(ctx, "reduce.pair", builder.getInt64(0), builder.getInt64(REDUCE_CHUNKS / (2 * stride)),
+                      [&](llvm::Value* pair) {
+            llvm::Value* left = builder.CreateMul(pair, builder.getInt64(2 * stride));
+            llvm::Value* right = builder.CreateAdd(left, builder.getInt64(stride));
+            llvm::Value* left_ptr = builder.CreateInBoundsGEP(partials_llvm_type, partials, {builder.getInt64(0), left});
+            llvm::Value* right_ptr = builder.CreateInBoundsGEP(partials_llvm_type, partials, {builder.getInt64(0), right});
+            llvm::Value* combined = emitReduceCombine(ctx, stmt.reduce_op, combine_function,
+                                                      builder.CreateLoad(acc.type, left_ptr),
+                                                      builder.CreateLoad(acc.type, right_ptr));
+            builder.CreateStore(combined, left_ptr);
+        });
+    }
+    llvm::Value* result = builder.CreateLoad(acc.type, builder.CreateConstInBoundsGEP2_64(partials_llvm_type, partials, 0, 0));
+    result = emitReduceCombine(ctx, stmt.reduce_op, combine_function, builder.CreateLoad(acc.type, acc.ptr), result);
+    builder.CreateStore(result, acc.ptr);
+    ctx.exitScope();
+    return nullptr;
+}
+
+llvm::Value* ParallelForStmt::codegen(CodeGenContext& ctx) {
+    llvm::IRBuilder<>& builder = ctx.getBuilder();
+    llvm::Type* i64_type = builder.getInt64Ty();
+    llvm::Type* ptr_type = llvm::PointerType::get(ctx.getContext(), 0);
+    
+    llvm::Value* start_value = start->codegen(ctx);
+    llvm::Value* end_value = end->codegen(ctx);
+    llvm::Value* chunk_value = chunk ? chunk->codegen(ctx) : builder.getInt64(0);  // 0: runtime default
+    if (!start_value || !end_value || !chunk_value) {
+        return nullptr;
+    }
+    start_value = ctx.convertIndex(start_value);
+    end_value = ctx.convertIndex(end_value);
+    chunk_value = ctx.convertIndex(chunk_value);
+    
+    if (reduce_op != NONE) {
+        return emitParallelReduce(ctx, *this, start_value, end_value);
+    }
+    
+    // Body function: for (var = lo; var < hi; var++) { body }
+    llvm::Value* env = nullptr;
+    llvm::Function* body_function = ctx.outlineRange("parallel_for", [&](llvm::Value* lo, llvm::Value* hi) {
+        emitRangeLoop(ctx, var, lo, hi, [&](llvm::Value*) {
+            for (auto& stmt : body) {
+                stmt->codegen(ctx);
+            }
+        });
+    }, env);
+    
+    // Runs every chunk on the thread pool and returns when all are done
+    llvm::FunctionCallee parallel_for = ctx.getModule()->getOrInsertFunction(
+        "__olang_parallel_for",
+        llvm::FunctionType::get(builder.getVoidTy(),
+                                {ptr_type, i64_type, i64_type, ptr_type, builder.getInt32Ty(), i64_type},
+                                false)
+    );
+    builder.CreateCall(parallel_for, {body_function, start_value, end_value, env,
+                                      builder.getInt32(schedule), chunk_value});
+    return nullptr;
+}
+
+llvm::Value* SyncStmt::codegen(CodeGenContext& ctx) {
+    llvm::FunctionCallee sync = ctx.getModule()->getOrInsertFunction(
+        "__olang_task_sync",
+        llvm::FunctionType::get(ctx.getBuilder().getVoidTy(), {llvm::PointerType::get(ctx.getContext(), 0)}, false)
+    );
+    llvm::Value* call = ctx.getBuilder().CreateCall(sync, {ctx.getTaskScope()});
+    ctx.clearTaskHandles();
+    return call;
+}
+
+// Alignment of the arena cursor (and of every fast-path allocation): must
+// match ARENA_ALIGN in runtime/olang_arena.c
+static const int64_t ARENA_ALIGN = 16;
+
+llvm::Value* ArenaStmt::codegen(CodeGenContext& ctx) {
+    llvm::IRBuilder<>& builder = ctx.getBuilder();
+    llvm::PointerType* ptr_type = llvm::PointerType::get(ctx.getContext(), 0);
+    ctx.enterScope();
+    llvm::AllocaInst* arena = ctx.createAlloca(name, Type(TypeKind::ARENA));
+    builder.CreateStore(llvm::ConstantAggregateZero::get(arena->getAllocatedType()), arena);
+    
+    // Release on every way out of the block; tasks spawned meanwhile may still use the memory
+    llvm::FunctionCallee release = ctx.getModule()->getOrInsertFunction(
+        "__olang_arena_release", llvm::FunctionType::get(builder.getVoidTy(), {ptr_type}, false)
+    );
+    llvm::FunctionCallee sync = ctx.getModule()->getOrInsertFunction(
+        "__olang_task_sync", llvm::FunctionType::get(builder.getVoidTy(), {ptr_type}, false)
+    );
+    size_t cleanup_depth = ctx.getCleanupDepth();
+    ctx.pushCleanup([&ctx, &builder, release, sync, arena]() {
+        if (llvm::Value* scope = ctx.findTaskScope()) {
+            builder.CreateCall(sync, {scope});
+            ctx.clearTaskHandles();
+        }
+        builder.CreateCall(release, {arena});
+    });
+    
+    for (auto& stmt : body) {
+        stmt->codegen(ctx);
+    }
+    if (!builder.GetInsertBlock()->getTerminator()) {
+        ctx.emitCleanups(cleanup_depth);
+    }
+    ctx.eraseCleanup(cleanup_depth);
+    ctx.exitScope();
+    return nullptr;
+}
+
+llvm::Value* AllocExpr::codegen(CodeGenContext& ctx) {
+    llvm::IRBuilder<>& builder = ctx.getBuilder();
+    llvm::LLVMContext& context = ctx.getContext();
+    
+    // First operand: an arena block's name or a *arena
+    Type arena_type;
+    llvm::Value* arena_ptr = ctx.emitAddress(arena.get(), arena_type);
+    if (arena_ptr && arena_type.kind == TypeKind::POINTER && arena_type.element_type->kind == TypeKind::ARENA) {
+        arena_ptr = builder.CreateLoad(ctx.getLLVMType(arena_type), arena_ptr, "arena.ptr");
+        arena_type = *arena_type.element_type;
+    }
+    if (!arena_ptr || arena_type.kind != TypeKind::ARENA) {
+        ctx.error() << "alloc needs an arena or *arena operand\n";
+        return nullptr;
+    }
+    // The bump pointer is not atomic: each parallel iteration needs its own arena
+    llvm::Function* function = builder.GetInsertBlock()->getParent();
+    auto local = llvm::dyn_cast<llvm::AllocaInst>(arena_ptr);
+    if (ctx.isInOutlinedRegion() && dynamic_cast<Identifier*>(arena.get()) && (!local || local->getFunction() != function)) {
+        ctx.error() << "alloc from an arena declared outside the parallel region\n";
+        return nullptr;
+    }
+    
+    llvm::Type* element_type = ctx.getLLVMType(type);
+    if (!element_type || element_type->isVoidTy()) {
+        ctx.error() << "alloc needs a sized element type\n";
+        return nullptr;
+    }
+    llvm::Value* count_value = count->codegen(ctx);
+    if (!count_value) {
+        return nullptr;
+    }
+    llvm::Type* i64_type = builder.getInt64Ty();
+    llvm::PointerType* ptr_type = llvm::PointerType::get(context, 0);
+    uint64_t element_size = ctx.getModule()->getDataLayout().getTypeAllocSize(element_type);
+    int64_t align = ctx.getTypeAlign(type).value();
+    // A negative count, or a size that overflows, becomes -1: it fails the
+    // fast path's fit test and __olang_arena_alloc aborts on it
+    llvm::Value* index = ctx.convertIndex(count_value);
+    llvm::Value* product = builder.CreateBinaryIntrinsic(llvm::Intrinsic::umul_with_overflow, index,
+                                                         builder.getInt64(element_size));
+    llvm::Value* invalid = builder.CreateOr(builder.CreateExtractValue(product, 1),
+                                            builder.CreateICmpSLT(index, builder.getInt64(0)));
+    llvm::Value* size = builder.CreateSelect(invalid, builder.getInt64(-1), builder.CreateExtractValue(product, 0),
+                                             "alloc.size");
+    
+    llvm::FunctionCallee slow_alloc = ctx.getModule()->getOrInsertFunction(
+        "__olang_arena_alloc", llvm::FunctionType::get(ptr_type, {ptr_type, i64_type, i64_type}, false)
+    );
+    if (align > ARENA_ALIGN) {
+        return builder.CreateCall(slow_alloc, {arena_ptr, size, builder.getInt64(align)}, "alloc");
+    }
+    
+    // Fast path: the cursor stays ARENA_ALIGN-aligned, so bumping it by the rounded size is enough
+    llvm::StructType* arena_struct = llvm::cast<llvm::StructType>(ctx.getLLVMType(arena_type));
+    llvm::Value* cur_ptr = builder.CreateStructGEP(arena_struct, arena_ptr, 0, "arena.cur");
+    llvm::Value* cur = builder.CreateLoad(ptr_type, cur_ptr, "cur");
+    llvm::Value* end = builder.CreateLoad(ptr_type, builder.CreateStructGEP(arena_struct, arena_ptr, 1), "end");
+    llvm::Value* rounded = builder.CreateAnd(builder.CreateAdd(size, builder.getInt64(ARENA_ALIGN - 1)),
+                                             builder.getInt64(~(ARENA_ALIGN - 1)), "alloc.rounded");
+    llvm::Value* available = builder.CreateSub(builder.CreatePtrToInt(end, i64_type),
+                                               builder.CreatePtrToInt(cur, i64_type), "arena.available");
+    // The second test catches sizes that wrapped around when rounded
+    llvm::Value* fits = builder.CreateAnd(builder.CreateICmpULE(rounded, available),
+                                          builder.CreateICmpULE(size, rounded), "alloc.fits");
+    llvm::BasicBlock* fast_block = llvm::BasicBlock::Create(context, "alloc.fast", function);
+    llvm::BasicBlock* slow_block = llvm::BasicBlock::Create(context, "alloc.slow", function);
+    llvm::BasicBlock* done_block = llvm::BasicBlock::Create(context, "alloc.done", function);
+    builder.CreateCondBr(fits, fast_block, slow_block);
+    
+    builder.SetInsertPoint(fast_block);
+    builder.CreateStore(builder.CreateGEP(builder.getInt8Ty(), cur, rounded), cur_ptr);
+    builder.CreateBr(done_block);
+    
+    builder.SetInsertPoint(slow_block);
+    llvm::Value* fresh = builder.CreateCall(slow_alloc, {arena_ptr, size, builder.getInt64(ARENA_ALIGN)}, "alloc.slow");
+    builder.CreateBr(done_block);
+    
+    builder.SetInsertPoint(done_block);
+    llvm::PHINode* result = builder.CreatePHI(ptr_type, 2, "alloc");
+    result->addIncoming(cur, fast_block);
+    result->addIncoming(fresh, slow_block);
+    return result;
+}
+
+llvm::Value* ProbeStmt::codegen(CodeGenContext& ctx) {
+    llvm::IRBuilder<>& builder = ctx.getBuilder();
+    llvm::Type* i16_type = llvm::Type::getInt16Ty(ctx.getContext());
+    
+    // Semaphore bumped by the tracer (bpftrace/SystemTap) while the probe is attached
+    std::string semaphore_name = provider + "_" + name + "_semaphore";
+    llvm::GlobalVariable* semaphore = ctx.getModule()->getNamedGlobal(semaphore_name);
+    if (!semaphore) {
+        semaphore = new llvm::GlobalVariable(
+            *ctx.getModule(), i16_type, false, llvm::GlobalValue::WeakAnyLinkage,
+            llvm::ConstantInt::get(i16_type, 0), semaphore_name
+        );
+        semaphore->setVisibility(llvm::GlobalValue::HiddenVisibility);
+        semaphore->setSection(".probes");
+        semaphore->setAlignment(llvm::Align(2));
+    }
+    
+    llvm::Function* function = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock* fire_block = llvm::BasicBlock::Create(ctx.getContext(), "probe_fire", function);
+    llvm::BasicBlock* end_block = llvm::BasicBlock::Create(ctx.getContext(), "probe_end", function);
+    
+    // Disabled probes only cost a load and a branch; arguments are not evaluated
+    llvm::LoadInst* enabled = builder.CreateLoad(i16_type, semaphore, "probe_sem");
+    enabled->setVolatile(true);
+    builder.CreateCondBr(
+        builder.CreateICmpNE(enabled, llvm::ConstantInt::get(i16_type, 0)), fire_block, end_block
+    );
+    
+    builder.SetInsertPoint(fire_block);
+    
+    // Argument descriptors use the sys/sdt.h format: [-]size@operand
+    std::vector<llvm::Value*> arg_values;
+    std::vector<llvm::Type*> arg_types;
+    std::string arg_spec;
+    std::string constraints;
+    for (size_t i = 0; i < args.size(); ++i) {
+        llvm::Value* value = args[i]->codegen(ctx);
+        if (!value) {
+            break;
+        }
+        
+        llvm::Type* type = value->getType();
+        std::string size;
+        if (type->isIntegerTy(1)) {
+            value = builder.CreateZExt(value, llvm::Type::getInt8Ty(ctx.getContext()));
+            size = "1";
+        } else if (type->isIntegerTy()) {
+            size = "-" + std::to_string(type->getIntegerBitWidth() / 8);
+        } else if (type->isPointerTy()) {
+            size = "8";
+        } else if (type->isFloatingPointTy()) {
+            // The descriptors have no float form: tracers would print the bits as an integer
+            ctx.error() << "probe " << provider << ":" << name
+                        << " argument " << i << " is a float; probes take integers and pointers\n";
+            break;
+        } else {
+            ctx.error() << "probe " << provider << ":" << name
+                        << " argument " << i << " must be a scalar\n";
+            break;
+        }
+        
+        arg_values.push_back(value);
+        arg_types.push_back(value->getType());
+        if (i > 0) {
+            arg_spec += " ";
+            constraints += ",";
+        }
+        arg_spec += size + "@$" + std::to_string(i);
+        constraints += "r";
+    }
+    
+    // A bad argument (already reported) still leaves probe_fire terminated
+    if (arg_values.size() != args.size()) {
+        builder.CreateBr(end_block);
+        builder.SetInsertPoint(end_block);
+        return nullptr;
+    }
+    
+    // nop at the probe site plus a .note.stapsdt entry describing it
+    std::string asm_str =
+        "990: nop\n"
+        ".pushsection .note.stapsdt,\"\",\"note\"\n"
+        ".balign 4\n"
+        ".4byte 992f-991f, 994f-993f, 3\n"
+        "991: .asciz \"stapsdt\"\n"
+        "992: .balign 4\n"
+        "993: .8byte 990b\n"
+        ".8byte _.stapsdt.base\n"
+        ".8byte " + semaphore_name + "\n"
+        ".asciz \"" + provider + "\"\n"
+        ".asciz \"" + name + "\"\n"
+        ".asciz \"" + arg_spec + "\"\n"
+        "994: .balign 4\n"
+        ".popsection\n"
+        ".ifndef _.stapsdt.base\n"
+        ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n"
+        ".weak _.stapsdt.base\n"
+        ".hidden _.stapsdt.base\n"
+        "_.stapsdt.base: .space 1\n"
+        ".size _.stapsdt.base, 1\n"
+        ".popsection\n"
+        ".endif\n";
+    
+    llvm::FunctionType* asm_type = llvm::FunctionType::get(
+        llvm::Type::getVoidTy(ctx.getContext()), arg_types, false
+    );
+    llvm::InlineAsm* probe_asm = llvm::InlineAsm::get(asm_type, asm_str, constraints, true);
+    builder.CreateCall(probe_asm, arg_values);
+    builder.CreateBr(end_block);
+    
+    builder.SetInsertPoint(end_block);
+    return nullptr;
+}
+
+// Expression code generation
+llvm::Value* IntLiteral::codegen(CodeGenContext& ctx) {
+    // Default to i32 type (most common)
+    return llvm::ConstantInt::get(ctx.getContext(), llvm::APInt(32, value, true));
+}
+
+llvm::Value* FloatLiteral::codegen(CodeGenContext& ctx) {
+    return llvm::ConstantFP::get(ctx.getContext(), llvm::APFloat(value));
+}
+
+llvm::Value* StringLiteral::codegen(CodeGenContext& ctx) {
+    // Not through the builder: global initializers have no insertion block
+    llvm::Constant* data = llvm::ConstantDataArray::getString(ctx.getContext(), value);
+    auto global = new llvm::GlobalVariable(
+        *ctx.getModule(), data->getType(), true, llvm::GlobalValue::PrivateLinkage, data, ".str"
+    );
+    global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+    global->setAlignment(llvm::Align(1));
+    return global;
+}
+
+llvm::Value* BoolLiteral::codegen(CodeGenContext& ctx) {
+    return llvm::ConstantInt::getBool(ctx.getContext(), value);
+}
+
+llvm::Value* Identifier::codegen(CodeGenContext& ctx) {
+    Variable var = ctx.getVariable(name);
+    if (var && var.olang_type.kind == TypeKind::TASK) {
+        ctx.error() << "task " << name << " can only be joined (handles cannot be copied)\n";
+        return nullptr;
+    }
+    if (var) {
+        llvm::LoadInst* load = ctx.getBuilder().CreateAlignedLoad(var.type, var.ptr, var.align, name);
+        if (var.olang_type.kind == TypeKind::ATOMIC) {
+            load->setAtomic(llvm::AtomicOrdering::SequentiallyConsistent);
+        }
+        return load;
+    }
+    return nullptr;
+}
+
+llvm::Value* BinaryExpr::codegen(CodeGenContext& ctx) {
+    llvm::Value* left_value = left->codegen(ctx);
+    llvm::Value* right_value = right->codegen(ctx);
+    
+    if (!left_value || !right_value) {
+        return nullptr;
+    }
+    
+    // Both operands must have the same type; a literal takes the other side's
+    // type (see convertValue)
+    llvm::Type* left_type = left_value->getType();
+    llvm::Type* right_type = right_value->getType();
+    if (left_type != right_type) {
+        if (llvm::isa<llvm::ConstantInt>(left_value) || llvm::isa<llvm::ConstantFP>(left_value)) {
+            left_value = ctx.convertValue(left_value, right_type);
+        } else {
+            right_value = ctx.convertValue(right_value, left_type);
+        }
+        if (left_value->getType() != right_value->getType()) {
+            return nullptr;
+        }
     }
     
     switch (op) {
@@ -376,6 +1713,18 @@ llvm::Value* BinaryExpr::codegen(CodeGenContext& ctx) {
 }
 
 llvm::Value* AssignmentExpr::codegen(CodeGenContext& ctx) {
+    // Slice destination: the element types must match
+    Type left_type;
+    if (getLValueType(ctx, left.get(), left_type) && left_type.kind == TypeKind::SLICE) {
+        llvm::Value* slice = emitSliceFor(ctx, right.get(), left_type, "slice assignment");
+        llvm::Value* ptr = slice ? ctx.emitAddress(left.get(), left_type) : nullptr;
+        if (!ptr) {
+            return nullptr;
+        }
+        ctx.getBuilder().CreateStore(slice, ptr);
+        return slice;
+    }
+    
     // Calculate right value
     llvm::Value* right_value = right->codegen(ctx);
     if (!right_value) {
@@ -384,9 +1733,13 @@ llvm::Value* AssignmentExpr::codegen(CodeGenContext& ctx) {
     
     // Handle simple variable assignment: x = value
     if (auto ident = dynamic_cast<Identifier*>(left.get())) {
-        llvm::AllocaInst* alloca = ctx.getAlloca(ident->name);
-        if (alloca) {
-            ctx.getBuilder().CreateStore(right_value, alloca);
+        Variable var = ctx.getVariable(ident->name);
+        if (var) {
+            llvm::StoreInst* store =
+                ctx.getBuilder().CreateAlignedStore(ctx.convertValue(right_value, var.type), var.ptr, var.align);
+            if (var.olang_type.kind == TypeKind::ATOMIC) {
+                store->setAtomic(llvm::AtomicOrdering::SequentiallyConsistent);
+            }
             return right_value;
         }
     }
@@ -394,9 +1747,24 @@ llvm::Value* AssignmentExpr::codegen(CodeGenContext& ctx) {
     // Handle array element assignment: arr[i] = value
     if (auto array_access = dynamic_cast<ArrayAccess*>(left.get())) {
         if (auto ident = dynamic_cast<Identifier*>(array_access->array.get())) {
-            llvm::AllocaInst* alloca = ctx.getAlloca(ident->name);
-            if (alloca) {
-                llvm::Type* array_type = alloca->getAllocatedType();
+            Variable var = ctx.getVariable(ident->name);
+            if (var && var.soa_record) {
+                llvm::Value* index_value = array_access->index->codegen(ctx);
+                ctx.storeSoAElement(var, index_value, right_value);
+                return right_value;
+            }
+            if (var && var.olang_type.kind == TypeKind::SLICE) {
+                Type element_type;
+                llvm::Value* element_ptr = ctx.emitAddress(array_access, element_type);
+                if (!element_ptr) {
+                    return nullptr;
+                }
+                ctx.getBuilder().CreateAlignedStore(ctx.convertValue(right_value, ctx.getLLVMType(element_type)),
+                                                    element_ptr, ctx.getTypeAlign(element_type));
+                return right_value;
+            }
+            if (var) {
+                llvm::Type* array_type = var.type;
                 if (array_type->isArrayTy()) {
                     llvm::Value* index_value = array_access->index->codegen(ctx);
                     
@@ -406,11 +1774,12 @@ llvm::Value* AssignmentExpr::codegen(CodeGenContext& ctx) {
                     indices.push_back(index_value);
                     
                     llvm::Value* element_ptr = ctx.getBuilder().CreateGEP(
-                        array_type, alloca, indices, "arrayidx"
+                        array_type, var.ptr, indices, "arrayidx"
                     );
                     
                     // Store value to array element
-                    ctx.getBuilder().CreateStore(right_value, element_ptr);
+                    llvm::Type* element_type = llvm::cast<llvm::ArrayType>(array_type)->getElementType();
+                    ctx.getBuilder().CreateStore(ctx.convertValue(right_value, element_type), element_ptr);
                     return right_value;
                 }
             }
@@ -420,26 +1789,25 @@ llvm::Value* AssignmentExpr::codegen(CodeGenContext& ctx) {
     // Handle struct member assignment: obj.member = value
     if (auto member_access = dynamic_cast<MemberAccess*>(left.get())) {
         if (auto ident = dynamic_cast<Identifier*>(member_access->object.get())) {
-            llvm::AllocaInst* alloca = ctx.getAlloca(ident->name);
-            if (alloca) {
-                llvm::Type* struct_type = alloca->getAllocatedType();
+            Variable var = ctx.getVariable(ident->name);
+            if (var) {
+                llvm::Type* struct_type = var.type;
                 if (struct_type->isStructTy()) {
                     llvm::StructType* llvm_struct = llvm::cast<llvm::StructType>(struct_type);
                     
                     // Find member index
-                    unsigned member_idx = 0;
-                    if (member_access->member == "x") member_idx = 0;
-                    else if (member_access->member == "y") member_idx = 1;
-                    else if (member_access->member == "z") member_idx = 2;
-                    else return nullptr;
+                    int member_idx = ctx.getMemberIndex(llvm_struct, member_access->member);
+                    if (member_idx < 0) return nullptr;
                     
                     // Get member pointer using GEP
                     llvm::Value* member_ptr = ctx.getBuilder().CreateStructGEP(
-                        llvm_struct, alloca, member_idx, member_access->member
+                        llvm_struct, var.ptr, member_idx, member_access->member
                     );
                     
                     // Store value to member
-                    ctx.getBuilder().CreateStore(right_value, member_ptr);
+                    llvm::Type* member_type = llvm_struct->getElementType(member_idx);
+                    ctx.getBuilder().CreateAlignedStore(ctx.convertValue(right_value, member_type), member_ptr,
+                                                        ctx.getMemberAlign(llvm_struct, member_idx, var.align));
                     return right_value;
                 }
             }
@@ -448,9 +1816,36 @@ llvm::Value* AssignmentExpr::codegen(CodeGenContext& ctx) {
         // Handle arr[i].member = value
         if (auto array_access = dynamic_cast<ArrayAccess*>(member_access->object.get())) {
             if (auto ident = dynamic_cast<Identifier*>(array_access->array.get())) {
-                llvm::AllocaInst* alloca = ctx.getAlloca(ident->name);
-                if (alloca) {
-                    llvm::Type* array_type = alloca->getAllocatedType();
+                Variable var = ctx.getVariable(ident->name);
+                if (var && var.soa_record) {
+                    // #[soa]: the member lives in its own array
+                    int member_idx = ctx.getMemberIndex(var.soa_record, member_access->member);
+                    if (member_idx < 0) return nullptr;
+                    llvm::Value* index_value = array_access->index->codegen(ctx);
+                    llvm::Value* member_ptr = ctx.createSoAFieldGEP(var, index_value, member_idx, member_access->member);
+                    llvm::Type* member_type = var.soa_record->getElementType(member_idx);
+                    ctx.getBuilder().CreateStore(ctx.convertValue(right_value, member_type), member_ptr);
+                    return right_value;
+                }
+                if (var && var.olang_type.kind == TypeKind::SLICE) {
+                    Type element_type;
+                    llvm::Value* element_ptr = ctx.emitAddress(array_access, element_type);
+                    auto* llvm_struct = llvm::dyn_cast_or_null<llvm::StructType>(
+                        element_ptr ? ctx.getLLVMType(element_type) : nullptr);
+                    int member_idx = llvm_struct ? ctx.getMemberIndex(llvm_struct, member_access->member) : -1;
+                    if (member_idx < 0) return nullptr;
+                    llvm::Value* member_ptr = ctx.getBuilder().CreateStructGEP(
+                        llvm_struct, element_ptr, member_idx, member_access->member
+                    );
+                    llvm::Type* member_type = llvm_struct->getElementType(member_idx);
+                    ctx.getBuilder().CreateAlignedStore(
+                        ctx.convertValue(right_value, member_type), member_ptr,
+                        ctx.getMemberAlign(llvm_struct, member_idx, ctx.getTypeAlign(element_type))
+                    );
+                    return right_value;
+                }
+                if (var) {
+                    llvm::Type* array_type = var.type;
                     if (array_type->isArrayTy()) {
                         llvm::Value* index_value = array_access->index->codegen(ctx);
                         
@@ -460,7 +1855,7 @@ llvm::Value* AssignmentExpr::codegen(CodeGenContext& ctx) {
                         indices.push_back(index_value);
                         
                         llvm::Value* element_ptr = ctx.getBuilder().CreateGEP(
-                            array_type, alloca, indices, "arrayidx"
+                            array_type, var.ptr, indices, "arrayidx"
                         );
                         
                         // Get element type (should be struct)
@@ -471,11 +1866,8 @@ llvm::Value* AssignmentExpr::codegen(CodeGenContext& ctx) {
                             llvm::StructType* llvm_struct = llvm::cast<llvm::StructType>(element_type);
                             
                             // Find member index
-                            unsigned member_idx = 0;
-                            if (member_access->member == "x") member_idx = 0;
-                            else if (member_access->member == "y") member_idx = 1;
-                            else if (member_access->member == "z") member_idx = 2;
-                            else return nullptr;
+                            int member_idx = ctx.getMemberIndex(llvm_struct, member_access->member);
+                            if (member_idx < 0) return nullptr;
                             
                             // Get member pointer from array element
                             llvm::Value* member_ptr = ctx.getBuilder().CreateStructGEP(
@@ -483,7 +1875,11 @@ llvm::Value* AssignmentExpr::codegen(CodeGenContext& ctx) {
                             );
                             
                             // Store value to member
-                            ctx.getBuilder().CreateStore(right_value, member_ptr);
+                            llvm::Type* member_type = llvm_struct->getElementType(member_idx);
+                            llvm::Align element_align = llvm::commonAlignment(
+                                var.align, ctx.getModule()->getDataLayout().getTypeAllocSize(element_type));
+                            ctx.getBuilder().CreateAlignedStore(ctx.convertValue(right_value, member_type), member_ptr,
+                                                                ctx.getMemberAlign(llvm_struct, member_idx, element_align));
                             return right_value;
                         }
                     }
@@ -496,6 +1892,22 @@ llvm::Value* AssignmentExpr::codegen(CodeGenContext& ctx) {
 }
 
 llvm::Value* UnaryExpr::codegen(CodeGenContext& ctx) {
+    if (op == ADDR) {
+        // &f on a function (not shadowed by a variable): its address, e.g. for C callbacks
+        if (auto identifier = dynamic_cast<Identifier*>(operand.get()); identifier && !ctx.getVariable(identifier->name)) {
+            if (llvm::Function* function = ctx.getModule()->getFunction(identifier->name)) {
+                return function;
+            }
+        }
+        Type type;
+        llvm::Value* address = ctx.emitAddress(operand.get(), type);
+        if (address && type.kind == TypeKind::TASK) {
+            ctx.error() << "task handles cannot be taken by address\n";
+            return nullptr;
+        }
+        return address;
+    }
+    
     llvm::Value* operand_value = operand->codegen(ctx);
     
     if (!operand_value) {
@@ -515,90 +1927,767 @@ llvm::Value* UnaryExpr::codegen(CodeGenContext& ctx) {
             // For opaque pointers in LLVM 18+, we need to specify the type explicitly
             // This is a simplified implementation - proper pointer types should be tracked
             return ctx.getBuilder().CreateLoad(llvm::Type::getInt32Ty(ctx.getContext()), operand_value, "dereftmp");
-        case ADDR:
-            if (auto ident = dynamic_cast<Identifier*>(operand.get())) {
-                llvm::AllocaInst* alloca = ctx.getAlloca(ident->name);
-                if (alloca) {
-                    return alloca;
-                }
-            }
-            return nullptr;
         default:
             return nullptr;
     }
 }
 
-llvm::Value* CallExpr::codegen(CodeGenContext& ctx) {
-    llvm::Function* callee = ctx.getModule()->getFunction(function_name);
-    if (!callee) {
+// Memory ordering argument of the atomic builtins: relaxed, acquire, release, acq_rel or seq_cst
+static bool getAtomicOrdering(ASTNode* arg, llvm::AtomicOrdering& ordering) {
+    auto ident = dynamic_cast<Identifier*>(arg);
+    if (!ident) {
+        return false;
+    }
+    if (ident->name == "relaxed") ordering = llvm::AtomicOrdering::Monotonic;
+    else if (ident->name == "acquire") ordering = llvm::AtomicOrdering::Acquire;
+    else if (ident->name == "release") ordering = llvm::AtomicOrdering::Release;
+    else if (ident->name == "acq_rel") ordering = llvm::AtomicOrdering::AcquireRelease;
+    else if (ident->name == "seq_cst") ordering = llvm::AtomicOrdering::SequentiallyConsistent;
+    else return false;
+    return true;
+}
+
+// Builtins on atomic<T> lvalues (or pointers to them) and fence(order)
+static llvm::Value* emitAtomicBuiltin(CodeGenContext& ctx, const std::string& name,
+                                      std::vector<std::unique_ptr<Expr>>& args) {
+    llvm::IRBuilder<>& builder = ctx.getBuilder();
+    
+    size_t arg_count = 0;
+    if (name == "fence") arg_count = 1;
+    else if (name == "atomic_load") arg_count = 2;
+    else if (name == "atomic_store" || name == "atomic_fetch_add" || name == "atomic_exchange") arg_count = 3;
+    else if (name == "atomic_cas") arg_count = 4;
+    else {
+        ctx.error() << "unknown atomic builtin " << name << "\n";
         return nullptr;
     }
     
-    std::vector<llvm::Value*> arg_values;
-    for (auto& arg : args) {
-        arg_values.push_back(arg->codegen(ctx));
+    llvm::AtomicOrdering ordering;
+    if (args.size() != arg_count || !getAtomicOrdering(args.back().get(), ordering)) {
+        ctx.error() << name << " needs " << arg_count - 1
+                    << " operand(s) and a relaxed/acquire/release/acq_rel/seq_cst ordering\n";
+        return nullptr;
     }
     
-    // Don't name call result if void function
-    if (callee->getReturnType()->isVoidTy()) {
-        return ctx.getBuilder().CreateCall(callee, arg_values);
-    } else {
-        return ctx.getBuilder().CreateCall(callee, arg_values, "calltmp");
+    if (name == "fence") {
+        if (ordering == llvm::AtomicOrdering::Monotonic) {
+            ctx.error() << "fence cannot be relaxed\n";
+            return nullptr;
+        }
+        return builder.CreateFence(ordering);
     }
-}
-
-llvm::Value* MemberAccess::codegen(CodeGenContext& ctx) {
-    // Handle simple struct variable: obj.member
-    if (auto ident = dynamic_cast<Identifier*>(object.get())) {
-        llvm::AllocaInst* alloca = ctx.getAlloca(ident->name);
-        if (alloca) {
-            llvm::Type* struct_type = alloca->getAllocatedType();
-            if (struct_type->isStructTy()) {
-                llvm::StructType* llvm_struct = llvm::cast<llvm::StructType>(struct_type);
-                
-                // Find member index
-                unsigned member_idx = 0;
-                if (member == "x") member_idx = 0;
-                else if (member == "y") member_idx = 1;
-                else if (member == "z") member_idx = 2;
-                else return nullptr;
-                
-                // Use GEP to access member
-                llvm::Value* member_ptr = ctx.getBuilder().CreateStructGEP(llvm_struct, alloca, member_idx, member);
-                llvm::Type* member_type = llvm_struct->getElementType(member_idx);
-                return ctx.getBuilder().CreateLoad(member_type, member_ptr, member);
-            }
+    
+    // First operand: an atomic<T> variable, element or field, or a *atomic<T>
+    Type type;
+    llvm::Value* ptr = ctx.emitAddress(args[0].get(), type);
+    if (ptr && type.kind == TypeKind::POINTER && type.element_type->kind == TypeKind::ATOMIC) {
+        ptr = builder.CreateLoad(ctx.getLLVMType(type), ptr, "atomic.ptr");
+        type = *type.element_type;
+    } else if (!ptr) {
+        if (auto unary = dynamic_cast<UnaryExpr*>(args[0].get()); unary && unary->op == UnaryExpr::ADDR) {
+            ptr = ctx.emitAddress(unary->operand.get(), type);
         }
-        
-        // If parameter (SSA value), use ExtractValue
-        llvm::Value* param_value = ctx.getValue(ident->name);
-        if (param_value && param_value->getType()->isStructTy()) {
-            unsigned member_idx = 0;
-            if (member == "x") member_idx = 0;
-            else if (member == "y") member_idx = 1;
-            else if (member == "z") member_idx = 2;
-            else return nullptr;
-            
-            return ctx.getBuilder().CreateExtractValue(param_value, member_idx, member);
+    }
+    if (!ptr || type.kind != TypeKind::ATOMIC) {
+        ctx.error() << name << " needs an atomic<T> operand\n";
+        return nullptr;
+    }
+    llvm::Type* value_type = ctx.getLLVMType(type);  // i8..i64 or pointer (checked by the parser)
+    llvm::Align align = ctx.getTypeAlign(type);
+    
+    auto operand = [&](size_t i) -> llvm::Value* {
+        llvm::Value* value = args[i]->codegen(ctx);
+        return value ? ctx.convertValue(value, value_type) : nullptr;
+    };
+    
+    if (name == "atomic_load") {
+        if (ordering == llvm::AtomicOrdering::Release || ordering == llvm::AtomicOrdering::AcquireRelease) {
+            ctx.error() << "atomic_load cannot be release or acq_rel\n";
+            return nullptr;
+        }
+        llvm::LoadInst* load = builder.CreateAlignedLoad(value_type, ptr, align, "atomic.load");
+        load->setAtomic(ordering);
+        return load;
+    }
+    if (name == "atomic_store") {
+        if (ordering == llvm::AtomicOrdering::Acquire || ordering == llvm::AtomicOrdering::AcquireRelease) {
+            ctx.error() << "atomic_store cannot be acquire or acq_rel\n";
+            return nullptr;
         }
+        llvm::Value* value = operand(1);
+        if (!value) {
+            return nullptr;
+        }
+        llvm::StoreInst* store = builder.CreateAlignedStore(value, ptr, align);
+        store->setAtomic(ordering);
+        return store;
+    }
+    if (name == "atomic_fetch_add" || name == "atomic_exchange") {
+        llvm::Value* value = operand(1);
+        if (!value) {
+            return nullptr;
+        }
+        if (name == "atomic_fetch_add" && !value_type->isIntegerTy()) {
+            ctx.error() << "atomic_fetch_add needs an atomic integer\n";
+            return nullptr;
+        }
+        llvm::AtomicRMWInst::BinOp op = name == "atomic_fetch_add" ? llvm::AtomicRMWInst::Add
+                                                                   : llvm::AtomicRMWInst::Xchg;
+        return builder.CreateAtomicRMW(op, ptr, value, align, ordering);
     }
     
-    // Handle array element member: arr[i].member
-    if (auto array_access = dynamic_cast<ArrayAccess*>(object.get())) {
-        if (auto ident = dynamic_cast<Identifier*>(array_access->array.get())) {
-            llvm::AllocaInst* alloca = ctx.getAlloca(ident->name);
-            if (alloca) {
-                llvm::Type* array_type = alloca->getAllocatedType();
-                if (array_type->isArrayTy()) {
-                    llvm::Value* index_value = array_access->index->codegen(ctx);
-                    
-                    // Get array element pointer
-                    std::vector<llvm::Value*> indices;
-                    indices.push_back(llvm::ConstantInt::get(ctx.getContext(), llvm::APInt(32, 0)));
+    // atomic_cas(x, expected, desired, order): returns the previous value,
+    // which equals expected iff the exchange happened
+    llvm::Value* expected = operand(1);
+    llvm::Value* desired = operand(2);
+    if (!expected || !desired) {
+        return nullptr;
+    }
+    llvm::AtomicOrdering failure_ordering = llvm::AtomicCmpXchgInst::getStrongestFailureOrdering(ordering);
+    llvm::Value* pair = builder.CreateAtomicCmpXchg(ptr, expected, desired, align, ordering, failure_ordering);
+    return builder.CreateExtractValue(pair, 0, "cas.prev");
+}
+
+// Channel builtins: send(c, v), recv(c), try_send(c, v) and try_recv(c, &out),
+// the try_ forms returning whether they succeeded. One attempt is inlined:
+// claim the position at tail (head), copy the value and publish the cell's
+// stamp. A cell that is not ready, or a lost race for the claim, goes to
+// runtime/olang_chan.c, which retries and, for send/recv, waits.
+static llvm::Value* emitChannelBuiltin(CodeGenContext& ctx, const std::string& name,
+                                       std::vector<std::unique_ptr<Expr>>& args) {
+    llvm::IRBuilder<>& builder = ctx.getBuilder();
+    llvm::LLVMContext& context = ctx.getContext();
+    bool sending = name == "send" || name == "try_send";
+    bool blocking = name == "send" || name == "recv";
+    size_t arg_count = name == "recv" ? 1 : 2;
+    if (args.size() != arg_count) {
+        ctx.error() << name << " needs " << arg_count << " operand(s)\n";
+        return nullptr;
+    }
+    
+    // First operand: a chan<T, N> variable, element or field, or a *chan<T, N>
+    Type type;
+    llvm::Value* chan = ctx.emitAddress(args[0].get(), type);
+    if (chan && type.kind == TypeKind::POINTER && type.element_type->kind == TypeKind::CHAN) {
+        chan = builder.CreateLoad(ctx.getLLVMType(type), chan, "chan.ptr");
+        type = *type.element_type;
+    }
+    if (!chan || type.kind != TypeKind::CHAN) {
+        ctx.error() << name << " needs a chan<T, N> operand\n";
+        return nullptr;
+    }
+    
+    llvm::StructType* chan_type = llvm::cast<llvm::StructType>(ctx.getLLVMType(type));
+    llvm::StructType* cell_type = llvm::cast<llvm::StructType>(
+        llvm::cast<llvm::ArrayType>(chan_type->getElementType(4))->getElementType());
+    llvm::Type* value_type = cell_type->getElementType(1);
+    const llvm::DataLayout& layout = ctx.getModule()->getDataLayout();
+    int64_t capacity = type.array_size;
+    int64_t cell_size = layout.getTypeAllocSize(cell_type);
+    int64_t value_offset = static_cast<uint64_t>(layout.getStructLayout(cell_type)->getElementOffset(1));
+    int64_t value_size = layout.getTypeAllocSize(value_type);
+    
+    llvm::Value* value = nullptr;  // send, try_send: the value to send
+    llvm::Value* out = nullptr;    // try_recv: where the received value goes
+    if (sending) {
+        value = args[1]->codegen(ctx);
+        if (!value) {
+            return nullptr;
+        }
+        value = ctx.convertValue(value, value_type);
+    } else if (name == "try_recv") {
+        // Second operand: &x, or a pointer variable, to a T
+        Type out_type;
+        auto unary = dynamic_cast<UnaryExpr*>(args[1].get());
+        if (unary && unary->op == UnaryExpr::ADDR) {
+            out = ctx.emitAddress(unary->operand.get(), out_type);
+        } else {
+            Type pointer_type;
+            llvm::Value* pointer_ptr = ctx.emitAddress(args[1].get(), pointer_type);
+            if (pointer_ptr && pointer_type.kind == TypeKind::POINTER) {
+                out = builder.CreateLoad(ctx.getLLVMType(pointer_type), pointer_ptr, "chan.out");
+                out_type = *pointer_type.element_type;
+            }
+        }
+        if (!out || out_type != *type.element_type) {
+            ctx.error() << "try_recv needs a pointer to a " << typeName(*type.element_type)
+                        << " to receive into, as in try_recv(c, &x)\n";
+            return nullptr;
+        }
+    }
+    
+    llvm::Function* function = builder.GetInsertBlock()->getParent();
+    llvm::Type* i64_type = builder.getInt64Ty();
+    llvm::Value* index_ptr = builder.CreateStructGEP(chan_type, chan, sending ? 0 : 2, sending ? "chan.tail" : "chan.head");
+    llvm::LoadInst* pos = builder.CreateAlignedLoad(i64_type, index_ptr, llvm::Align(8), "chan.pos");
+    pos->setAtomic(llvm::AtomicOrdering::Monotonic);
+    llvm::Value* lap = builder.CreateAnd(pos, builder.getInt64(~(capacity - 1)), "chan.lap");
+    llvm::Value* cell = builder.CreateInBoundsGEP(
+        chan_type, chan, {builder.getInt32(0), builder.getInt32(4), builder.CreateAnd(pos, builder.getInt64(capacity - 1))},
+        "chan.cell");
+    llvm::Value* stamp_ptr = builder.CreateStructGEP(cell_type, cell, 0);
+    llvm::LoadInst* stamp = builder.CreateAlignedLoad(i64_type, stamp_ptr, llvm::Align(8), "chan.stamp");
+    stamp->setAtomic(llvm::AtomicOrdering::Acquire);
+    
+    // A sender needs a free cell (stamp == lap), a receiver a full one (stamp == lap + 1)
+    llvm::Value* ready = builder.CreateICmpEQ(stamp, sending ? lap : builder.CreateAdd(lap, builder.getInt64(1)));
+    llvm::BasicBlock* claim_block = llvm::BasicBlock::Create(context, "chan.claim", function);
+    llvm::BasicBlock* fast_block = llvm::BasicBlock::Create(context, "chan.fast", function);
+    llvm::BasicBlock* slow_block = llvm::BasicBlock::Create(context, "chan.slow", function);
+    llvm::BasicBlock* done_block = llvm::BasicBlock::Create(context, "chan.done", function);
+    builder.CreateCondBr(ready, claim_block, slow_block);
+    
+    builder.SetInsertPoint(claim_block);
+    llvm::Value* next = builder.CreateAdd(pos, builder.getInt64(1));
+    // Tagged for SpscChannelPass, which turns the claim into a plain store
+    // where it proves the channel has one sending and one receiving thread
+    llvm::AtomicCmpXchgInst* claim = builder.CreateAtomicCmpXchg(
+        index_ptr, pos, next, llvm::Align(8), llvm::AtomicOrdering::Monotonic, llvm::AtomicOrdering::Monotonic);
+    claim->setMetadata(CHAN_CLAIM_METADATA, llvm::MDNode::get(context, llvm::MDString::get(context, sending ? "send" : "recv")));
+    builder.CreateCondBr(builder.CreateExtractValue(claim, 1), fast_block, slow_block);
+    
+    builder.SetInsertPoint(fast_block);
+    llvm::Value* value_ptr = builder.CreateStructGEP(cell_type, cell, 1);
+    llvm::Value* received = nullptr;
+    if (sending) {
+        builder.CreateStore(value, value_ptr);
+    } else {
+        received = builder.CreateLoad(value_type, value_ptr, "chan.value");
+        if (out) {
+            builder.CreateStore(received, out);
+        }
+    }
+    llvm::Value* new_stamp = builder.CreateAdd(lap, builder.getInt64(sending ? 1 : capacity));
+    llvm::StoreInst* publish = builder.CreateAlignedStore(new_stamp, stamp_ptr, llvm::Align(8));
+    publish->setAtomic(llvm::AtomicOrdering::Release);
+    builder.CreateBr(done_block);
+    
+    builder.SetInsertPoint(slow_block);
+    llvm::Value* buffer = out;
+    if (!buffer) {
+        llvm::IRBuilder<> entry_builder(&function->getEntryBlock(), function->getEntryBlock().begin());
+        buffer = entry_builder.CreateAlloca(value_type, nullptr, "chan.buffer");
+    }
+    if (sending) {
+        builder.CreateStore(value, buffer);
+    }
+    llvm::Type* ptr_type = llvm::PointerType::get(context, 0);
+    llvm::FunctionCallee runtime_function = ctx.getModule()->getOrInsertFunction(
+        "__olang_chan_" + name,
+        llvm::FunctionType::get(blocking ? builder.getVoidTy() : builder.getInt32Ty(),
+                                {ptr_type, ptr_type, i64_type, i64_type, i64_type, i64_type}, false)
+    );
+    llvm::Value* slow_call = builder.CreateCall(runtime_function, {
+        chan, buffer, builder.getInt64(capacity), builder.getInt64(cell_size),
+        builder.getInt64(value_offset), builder.getInt64(value_size)
+    });
+    llvm::Value* slow_result = nullptr;
+    if (name == "recv") {
+        slow_result = builder.CreateLoad(value_type, buffer, "chan.value");
+    } else if (!blocking) {
+        slow_result = builder.CreateICmpNE(slow_call, builder.getInt32(0));
+    }
+    llvm::BasicBlock* slow_end = builder.GetInsertBlock();
+    builder.CreateBr(done_block);
+    
+    builder.SetInsertPoint(done_block);
+    if (name == "send") {
+        return slow_call;
+    }
+    llvm::PHINode* result = builder.CreatePHI(slow_result->getType(), 2, name);
+    result->addIncoming(name == "recv" ? received : builder.getTrue(), fast_block);
+    result->addIncoming(slow_result, slow_end);
+    return result;
+}
+
+// Call an async fn's ramp: creates its frame, suspended before the body, and returns the handle
+static llvm::Value* emitAsyncStart(CodeGenContext& ctx, CallExpr* call) {
+    llvm::Function* callee = ctx.getModule()->getFunction(call->function_name);
+    if (!callee || callee->arg_size() != call->args.size()) {
+        ctx.error() << "wrong number of arguments to async fn " << call->function_name << "\n";
+        return nullptr;
+    }
+    std::vector<llvm::Value*> arg_values;
+    for (size_t i = 0; i < call->args.size(); ++i) {
+        llvm::Value* value = emitArgument(ctx, call->function_name, i, call->args[i].get(),
+                                          callee->getFunctionType()->getParamType(i));
+        if (!value) {
+            return nullptr;
+        }
+        arg_values.push_back(value);
+    }
+    return ctx.getBuilder().CreateCall(callee, arg_values, "coro");
+}
+
+// Read the result of a finished coroutine and destroy its frame
+static llvm::Value* finishAsync(CodeGenContext& ctx, llvm::Value* handle, const AsyncFunction& async_function) {
+    llvm::IRBuilder<>& builder = ctx.getBuilder();
+    llvm::Module* module = ctx.getModule();
+    llvm::Value* result = nullptr;
+    if (async_function.result.kind != TypeKind::VOID) {
+        llvm::Align promise_align = module->getDataLayout().getABITypeAlign(async_function.promise_type);
+        llvm::Value* promise = builder.CreateCall(
+            llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::coro_promise),
+            {handle, builder.getInt32(promise_align.value()), builder.getFalse()}
+        );
+        result = builder.CreateLoad(async_function.promise_type->getElementType(3),
+                                    builder.CreateStructGEP(async_function.promise_type, promise, 3), "async.result");
+    }
+    llvm::Value* destroy = builder.CreateCall(
+        llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::coro_destroy), {handle}
+    );
+    return result ? result : destroy;
+}
+
+llvm::Value* AwaitExpr::codegen(CodeGenContext& ctx) {
+    llvm::IRBuilder<>& builder = ctx.getBuilder();
+    llvm::Module* module = ctx.getModule();
+    AsyncFrame* frame = ctx.getAsyncFrame();
+    if (!frame || ctx.isInOutlinedRegion()) {
+        ctx.error() << "await outside an async fn\n";
+        return nullptr;
+    }
+    auto call_expr = dynamic_cast<CallExpr*>(call.get());
+    const AsyncFunction* async_function = call_expr ? ctx.getAsyncFunction(call_expr->function_name) : nullptr;
+    if (!async_function) {
+        ctx.error() << "await needs a call to an async fn\n";
+        return nullptr;
+    }
+    llvm::PointerType* ptr_type = llvm::PointerType::get(ctx.getContext(), 0);
+    
+    // extern async fn: hand it our handle, suspend, and read the result it completed us with
+    if (!async_function->promise_type) {
+        llvm::Function* callee = module->getFunction(call_expr->function_name);
+        if (callee->arg_size() != call_expr->args.size() + 1) {
+            ctx.error() << "wrong number of arguments to async fn " << call_expr->function_name << "\n";
+            return nullptr;
+        }
+        std::vector<llvm::Value*> arg_values = {frame->handle};
+        for (size_t i = 0; i < call_expr->args.size(); ++i) {
+            llvm::Value* value = emitArgument(ctx, call_expr->function_name, i, call_expr->args[i].get(),
+                                              callee->getFunctionType()->getParamType(i + 1));
+            if (!value) {
+                return nullptr;
+            }
+            arg_values.push_back(value);
+        }
+        builder.CreateCall(callee, arg_values);
+        emitSuspend(ctx, *frame, "await.resume");
+        llvm::Value* result = builder.CreateLoad(builder.getInt64Ty(),
+                                                 builder.CreateStructGEP(frame->promise_type, frame->promise, 1),
+                                                 "await.result");
+        if (async_function->result.kind == TypeKind::VOID) {
+            return result;
+        }
+        // The leaf completes with an i64; the declared result may be narrower
+        return builder.CreateTrunc(result, ctx.getLLVMType(async_function->result), "await.result");
+    }
+    
+    // Run the callee inline until it first suspends. If it has not finished by
+    // then, suspend too: the executor resumes us once the callee is done.
+    llvm::Value* handle = emitAsyncStart(ctx, call_expr);
+    if (!handle) {
+        return nullptr;
+    }
+    llvm::FunctionCallee run = module->getOrInsertFunction(
+        "__olang_async_run", llvm::FunctionType::get(builder.getInt32Ty(), {ptr_type, ptr_type}, false)
+    );
+    llvm::Value* finished = builder.CreateCall(run, {handle, frame->handle}, "await.finished");
+    llvm::Function* function = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock* wait_block = llvm::BasicBlock::Create(ctx.getContext(), "await.wait", function);
+    llvm::BasicBlock* ready_block = llvm::BasicBlock::Create(ctx.getContext(), "await.ready");
+    builder.CreateCondBr(builder.CreateICmpNE(finished, builder.getInt32(0)), ready_block, wait_block);
+    
+    builder.SetInsertPoint(wait_block);
+    emitSuspend(ctx, *frame, "await.resume");
+    builder.CreateBr(ready_block);
+    
+    ready_block->insertInto(function);
+    builder.SetInsertPoint(ready_block);
+    return finishAsync(ctx, handle, *async_function);
+}
+
+// block_on(f(args)): run the executor until f finishes and return its result.
+// detach(f(args)): hand f to the executor, which frees it when it finishes.
+// pool_alloc(p) / pool_free(p, x): pop / push the calling thread's free list
+// inline; the runtime refills it from the depot or a new slab, and moves a
+// batch to the depot when it grows past POOL_FLUSH
+static llvm::Value* emitPoolBuiltin(CodeGenContext& ctx, const std::string& name,
+                                    std::vector<std::unique_ptr<Expr>>& args) {
+    llvm::IRBuilder<>& builder = ctx.getBuilder();
+    llvm::LLVMContext& context = ctx.getContext();
+    bool freeing = name == "pool_free";
+    size_t arg_count = freeing ? 2 : 1;
+    if (args.size() != arg_count) {
+        ctx.error() << name << " needs " << arg_count << " operand(s)\n";
+        return nullptr;
+    }
+    auto identifier = dynamic_cast<Identifier*>(args[0].get());
+    Variable var = identifier ? ctx.getVariable(identifier->name) : Variable{};
+    llvm::GlobalVariable* depot =
+        identifier ? ctx.getModule()->getNamedGlobal(identifier->name + ".depot") : nullptr;
+    if (!var || var.olang_type.kind != TypeKind::POOL || !depot) {
+        ctx.error() << name << " needs a global pool<T> operand\n";
+        return nullptr;
+    }
+    
+    // Slots hold the free-list link while free, so they are at least pointer sized
+    llvm::Type* element_type = ctx.getLLVMType(*var.olang_type.element_type);
+    if (!element_type || element_type->isVoidTy()) {
+        ctx.error() << "pool " << identifier->name << " needs a sized element type\n";
+        return nullptr;
+    }
+    const llvm::DataLayout& layout = ctx.getModule()->getDataLayout();
+    uint64_t align = std::max<uint64_t>(ctx.getTypeAlign(*var.olang_type.element_type).value(), 8);
+    uint64_t slot_size = llvm::alignTo(std::max<uint64_t>(layout.getTypeAllocSize(element_type), 8), align);
+    
+    llvm::Type* i64_type = builder.getInt64Ty();
+    llvm::PointerType* ptr_type = llvm::PointerType::get(context, 0);
+    llvm::StructType* pool_type = llvm::cast<llvm::StructType>(var.type);
+    llvm::Value* head_ptr = builder.CreateStructGEP(pool_type, var.ptr, 0, "pool.head");
+    llvm::Value* count_ptr = builder.CreateStructGEP(pool_type, var.ptr, 1, "pool.count");
+    llvm::Value* count = builder.CreateLoad(i64_type, count_ptr, "pool.count");
+    
+    llvm::Value* object = nullptr;
+    if (freeing) {
+        object = args[1]->codegen(ctx);
+        if (!object || !object->getType()->isPointerTy()) {
+            ctx.error() << "pool_free needs a pointer from pool_alloc\n";
+            return nullptr;
+        }
+    }
+    
+    llvm::Function* function = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock* fast_block = llvm::BasicBlock::Create(context, "pool.fast", function);
+    llvm::BasicBlock* slow_block = llvm::BasicBlock::Create(context, "pool.slow", function);
+    llvm::BasicBlock* done_block = llvm::BasicBlock::Create(context, "pool.done", function);
+    llvm::Value* head = builder.CreateLoad(ptr_type, head_ptr, "pool.head");
+    
+    if (freeing) {
+        builder.CreateCondBr(builder.CreateICmpSLT(count, builder.getInt64(POOL_FLUSH)), fast_block, slow_block);
+        builder.SetInsertPoint(fast_block);
+        builder.CreateStore(head, object);
+        builder.CreateStore(object, head_ptr);
+        builder.CreateStore(builder.CreateAdd(count, builder.getInt64(1)), count_ptr);
+        builder.CreateBr(done_block);
+        
+        builder.SetInsertPoint(slow_block);
+        llvm::FunctionCallee slow_free = ctx.getModule()->getOrInsertFunction(
+            "__olang_pool_free", llvm::FunctionType::get(builder.getVoidTy(), {ptr_type, ptr_type, ptr_type}, false)
+        );
+        builder.CreateCall(slow_free, {var.ptr, depot, object});
+        builder.CreateBr(done_block);
+        builder.SetInsertPoint(done_block);
+        return nullptr;
+    }
+    
+    builder.CreateCondBr(builder.CreateIsNotNull(head), fast_block, slow_block);
+    builder.SetInsertPoint(fast_block);
+    builder.CreateStore(builder.CreateLoad(ptr_type, head, "pool.next"), head_ptr);
+    builder.CreateStore(builder.CreateSub(count, builder.getInt64(1)), count_ptr);
+    builder.CreateBr(done_block);
+    
+    builder.SetInsertPoint(slow_block);
+    llvm::FunctionCallee slow_alloc = ctx.getModule()->getOrInsertFunction(
+        "__olang_pool_alloc", llvm::FunctionType::get(ptr_type, {ptr_type, ptr_type, i64_type, i64_type}, false)
+    );
+    llvm::Value* fresh = builder.CreateCall(slow_alloc, {var.ptr, depot, builder.getInt64(slot_size),
+                                                         builder.getInt64(align)}, "pool.slow");
+    builder.CreateBr(done_block);
+    
+    builder.SetInsertPoint(done_block);
+    llvm::PHINode* result = builder.CreatePHI(ptr_type, 2, "pool_alloc");
+    result->addIncoming(head, fast_block);
+    result->addIncoming(fresh, slow_block);
+    return result;
+}
+
+static llvm::Value* emitAsyncBuiltin(CodeGenContext& ctx, const std::string& name,
+                                     std::vector<std::unique_ptr<Expr>>& args) {
+    llvm::IRBuilder<>& builder = ctx.getBuilder();
+    auto call_expr = args.size() == 1 ? dynamic_cast<CallExpr*>(args[0].get()) : nullptr;
+    const AsyncFunction* async_function = call_expr ? ctx.getAsyncFunction(call_expr->function_name) : nullptr;
+    if (!async_function || !async_function->promise_type) {
+        ctx.error() << name << " needs a call to an async fn\n";
+        return nullptr;
+    }
+    if (name == "block_on" && ctx.getAsyncFrame()) {
+        ctx.error() << "block_on inside an async fn (use await)\n";
+        return nullptr;
+    }
+    llvm::Value* handle = emitAsyncStart(ctx, call_expr);
+    if (!handle) {
+        return nullptr;
+    }
+    llvm::FunctionCallee runtime_function = ctx.getModule()->getOrInsertFunction(
+        "__olang_async_" + name,
+        llvm::FunctionType::get(builder.getVoidTy(), {llvm::PointerType::get(ctx.getContext(), 0)}, false)
+    );
+    llvm::Value* call = builder.CreateCall(runtime_function, {handle});
+    if (name == "detach") {
+        return call;
+    }
+    return finishAsync(ctx, handle, *async_function);
+}
+
+// as_slice(arr) / as_slice(p, n) (see emitAsSlice); len(x): length of a slice or array
+static llvm::Value* emitSliceBuiltin(CodeGenContext& ctx, const std::string& name,
+                                     std::vector<std::unique_ptr<Expr>>& args) {
+    llvm::IRBuilder<>& builder = ctx.getBuilder();
+    llvm::Type* slice_type = ctx.getLLVMType(Type(TypeKind::SLICE, std::make_shared<Type>(TypeKind::I8)));
+    
+    if (name == "len") {
+        if (args.size() != 1) {
+            ctx.error() << "len takes a slice or array\n";
+            return nullptr;
+        }
+        if (auto ident = dynamic_cast<Identifier*>(args[0].get())) {
+            Variable var = ctx.getVariable(ident->name);
+            if (var && var.olang_type.kind == TypeKind::ARRAY) {
+                return builder.getInt64(var.olang_type.array_size);
+            }
+        }
+        llvm::Value* slice = args[0]->codegen(ctx);
+        if (!slice || slice->getType() != slice_type) {
+            ctx.error() << "len needs a slice or array\n";
+            return nullptr;
+        }
+        return builder.CreateExtractValue(slice, 1, "len");
+    }
+    
+    Type type;
+    return emitAsSlice(ctx, args, type);
+}
+
+llvm::Value* CallExpr::codegen(CodeGenContext& ctx) {
+    llvm::Function* callee = ctx.getModule()->getFunction(function_name);
+    
+    if (!callee && (function_name == "fence" || function_name == "atomic_load" || function_name == "atomic_store" ||
+                    function_name == "atomic_fetch_add" || function_name == "atomic_exchange" ||
+                    function_name == "atomic_cas")) {
+        return emitAtomicBuiltin(ctx, function_name, args);
+    }
+    if (!callee && (function_name == "send" || function_name == "recv" ||
+                    function_name == "try_send" || function_name == "try_recv")) {
+        return emitChannelBuiltin(ctx, function_name, args);
+    }
+    if (!callee && (function_name == "pool_alloc" || function_name == "pool_free")) {
+        return emitPoolBuiltin(ctx, function_name, args);
+    }
+    if (!callee && (function_name == "block_on" || function_name == "detach")) {
+        return emitAsyncBuiltin(ctx, function_name, args);
+    }
+    if (!callee && (function_name == "as_slice" || function_name == "len")) {
+        return emitSliceBuiltin(ctx, function_name, args);
+    }
+    if (ctx.getAsyncFunction(function_name)) {
+        ctx.error() << "async fn " << function_name << " must be called with await, block_on or detach\n";
+        return nullptr;
+    }
+    
+    // join(h): wait for a spawned task (running other tasks meanwhile) and return its result
+    if (!callee && function_name == "join" && args.size() == 1) {
+        Type type;
+        llvm::Value* handle_ptr = ctx.emitAddress(args[0].get(), type);
+        if (!handle_ptr || type.kind != TypeKind::TASK) {
+            ctx.error() << "join needs a task<T> variable\n";
+            return nullptr;
+        }
+        llvm::IRBuilder<>& builder = ctx.getBuilder();
+        llvm::PointerType* ptr_type = llvm::PointerType::get(ctx.getContext(), 0);
+        llvm::Value* handle = builder.CreateLoad(ptr_type, handle_ptr, "task");
+        llvm::FunctionCallee task_join = ctx.getModule()->getOrInsertFunction(
+            "__olang_task_join", llvm::FunctionType::get(builder.getVoidTy(), {ptr_type}, false)
+        );
+        llvm::Value* joined = builder.CreateCall(task_join, {handle});
+        if (type.element_type->kind == TypeKind::VOID) {
+            return joined;
+        }
+        return builder.CreateLoad(ctx.getLLVMType(*type.element_type), handle, "join");
+    }
+    
+    // black_box(x): opaque identity that keeps x (and what it depends on) alive
+    if (!callee && function_name == "black_box" && args.size() == 1) {
+        llvm::Value* value = args[0]->codegen(ctx);
+        if (!value) {
+            return nullptr;
+        }
+        llvm::Type* type = value->getType();
+        bool is_bool = type->isIntegerTy(1);
+        if (is_bool) {
+            type = llvm::Type::getInt8Ty(ctx.getContext());
+            value = ctx.getBuilder().CreateZExt(value, type);
+        }
+        const char* constraints = type->isFloatingPointTy() ? "=x,0,~{memory}" : "=r,0,~{memory}";
+        llvm::InlineAsm* opaque = llvm::InlineAsm::get(
+            llvm::FunctionType::get(type, {type}, false), "", constraints, true
+        );
+        llvm::Value* result = ctx.getBuilder().CreateCall(opaque, {value}, "black_box");
+        return is_bool ? ctx.getBuilder().CreateTrunc(result, llvm::Type::getInt1Ty(ctx.getContext())) : result;
+    }
+    
+    if (!callee) {
+        return nullptr;
+    }
+    
+    std::vector<llvm::Value*> arg_values;
+    for (size_t i = 0; i < args.size(); ++i) {
+        llvm::Value* value = emitArgument(ctx, function_name, i, args[i].get(),
+                                          i < callee->arg_size() ? callee->getFunctionType()->getParamType(i) : nullptr);
+        arg_values.push_back(value);
+    }
+    
+    // --heap-profile: call the instrumented allocator, tagged with the calling function
+    if (ctx.isHeapProfile()) {
+        if (llvm::Function* hook = ctx.getHeapProfileHook(callee)) {
+            llvm::Function* caller = ctx.getBuilder().GetInsertBlock()->getParent();
+            std::string site_name = "heap.site." + caller->getName().str();
+            llvm::Value* site = ctx.getModule()->getNamedGlobal(site_name);
+            if (!site) {
+                site = ctx.getBuilder().CreateGlobalStringPtr(caller->getName(), site_name);
+            }
+            arg_values.push_back(site);
+            callee = hook;
+        }
+    }
+    
+    // Don't name call result if void function
+    if (callee->getReturnType()->isVoidTy()) {
+        return ctx.getBuilder().CreateCall(callee, arg_values);
+    } else {
+        return ctx.getBuilder().CreateCall(callee, arg_values, "calltmp");
+    }
+}
+
+llvm::Value* SpawnExpr::codegen(CodeGenContext& ctx) {
+    llvm::IRBuilder<>& builder = ctx.getBuilder();
+    llvm::Module* module = ctx.getModule();
+    llvm::Function* callee = module->getFunction(function_name);
+    if (ctx.getAsyncFrame() && !ctx.isInOutlinedRegion()) {
+        ctx.error() << "spawn inside an async fn\n";
+        return nullptr;
+    }
+    if (!callee || callee->isVarArg() || callee->arg_size() != args.size() || ctx.getAsyncFunction(function_name)) {
+        ctx.error() << "spawn needs a call to a defined function with matching arguments: "
+                    << function_name << "\n";
+        return nullptr;
+    }
+    llvm::FunctionType* callee_type = callee->getFunctionType();
+    llvm::PointerType* ptr_type = llvm::PointerType::get(ctx.getContext(), 0);
+    
+    // Task payload: the result first (where join reads it), then the arguments
+    std::vector<llvm::Type*> payload_fields;
+    bool has_result = !callee_type->getReturnType()->isVoidTy();
+    if (has_result) {
+        payload_fields.push_back(callee_type->getReturnType());
+    }
+    unsigned first_arg = payload_fields.size();
+    for (llvm::Type* param_type : callee_type->params()) {
+        payload_fields.push_back(param_type);
+    }
+    llvm::StructType* payload_type = llvm::StructType::get(ctx.getContext(), payload_fields);
+    
+    // Thunk run by the scheduler: void f.spawn(ptr payload)
+    std::string thunk_name = callee->getName().str() + ".spawn";
+    llvm::Function* thunk = module->getFunction(thunk_name);
+    if (!thunk) {
+        thunk = llvm::Function::Create(
+            llvm::FunctionType::get(builder.getVoidTy(), {ptr_type}, false),
+            llvm::Function::InternalLinkage, thunk_name, module
+        );
+        llvm::IRBuilder<> thunk_builder(llvm::BasicBlock::Create(ctx.getContext(), "entry", thunk));
+        llvm::Value* payload = thunk->getArg(0);
+        std::vector<llvm::Value*> call_args;
+        for (unsigned i = 0; i < callee->arg_size(); ++i) {
+            llvm::Value* arg_ptr = thunk_builder.CreateStructGEP(payload_type, payload, first_arg + i);
+            call_args.push_back(thunk_builder.CreateLoad(payload_fields[first_arg + i], arg_ptr));
+        }
+        llvm::Value* result = thunk_builder.CreateCall(callee, call_args);
+        if (has_result) {
+            thunk_builder.CreateStore(result, thunk_builder.CreateStructGEP(payload_type, payload, 0));
+        }
+        thunk_builder.CreateRetVoid();
+    }
+    
+    std::vector<llvm::Value*> arg_values;
+    for (size_t i = 0; i < args.size(); ++i) {
+        llvm::Value* value = emitArgument(ctx, function_name, i, args[i].get(), callee_type->getParamType(i));
+        if (!value) {
+            return nullptr;
+        }
+        arg_values.push_back(value);
+    }
+    
+    llvm::FunctionCallee task_alloc = module->getOrInsertFunction(
+        "__olang_task_alloc", llvm::FunctionType::get(ptr_type, {builder.getInt64Ty()}, false)
+    );
+    llvm::FunctionCallee task_spawn = module->getOrInsertFunction(
+        "__olang_task_spawn", llvm::FunctionType::get(builder.getVoidTy(), {ptr_type, ptr_type, ptr_type}, false)
+    );
+    uint64_t payload_size = module->getDataLayout().getTypeAllocSize(payload_type);
+    llvm::Value* payload = builder.CreateCall(task_alloc, {builder.getInt64(payload_size)}, "task");
+    for (size_t i = 0; i < arg_values.size(); ++i) {
+        builder.CreateStore(arg_values[i], builder.CreateStructGEP(payload_type, payload, first_arg + i));
+    }
+    builder.CreateCall(task_spawn, {ctx.getTaskScope(), thunk, payload});
+    return payload;
+}
+
+llvm::Value* MemberAccess::codegen(CodeGenContext& ctx) {
+    // Handle simple struct variable: obj.member
+    if (auto ident = dynamic_cast<Identifier*>(object.get())) {
+        Variable var = ctx.getVariable(ident->name);
+        if (var) {
+            llvm::Type* struct_type = var.type;
+            if (struct_type->isStructTy()) {
+                llvm::StructType* llvm_struct = llvm::cast<llvm::StructType>(struct_type);
+                
+                // Find member index
+                int member_idx = ctx.getMemberIndex(llvm_struct, member);
+                if (member_idx < 0) return nullptr;
+                
+                // Use GEP to access member
+                llvm::Value* member_ptr = ctx.getBuilder().CreateStructGEP(llvm_struct, var.ptr, member_idx, member);
+                llvm::Type* member_type = llvm_struct->getElementType(member_idx);
+                return ctx.getBuilder().CreateAlignedLoad(member_type, member_ptr,
+                                                          ctx.getMemberAlign(llvm_struct, member_idx, var.align), member);
+            }
+        }
+        
+        // If parameter (SSA value), use ExtractValue
+        llvm::Value* param_value = ctx.getValue(ident->name);
+        if (param_value && param_value->getType()->isStructTy()) {
+            int member_idx = ctx.getMemberIndex(llvm::cast<llvm::StructType>(param_value->getType()), member);
+            if (member_idx < 0) return nullptr;
+            
+            return ctx.getBuilder().CreateExtractValue(param_value, member_idx, member);
+        }
+    }
+    
+    // Handle array element member: arr[i].member
+    if (auto array_access = dynamic_cast<ArrayAccess*>(object.get())) {
+        if (auto ident = dynamic_cast<Identifier*>(array_access->array.get())) {
+            Variable var = ctx.getVariable(ident->name);
+            if (var && var.soa_record) {
+                // #[soa]: the member lives in its own array
+                int member_idx = ctx.getMemberIndex(var.soa_record, member);
+                if (member_idx < 0) return nullptr;
+                llvm::Value* index_value = array_access->index->codegen(ctx);
+                llvm::Value* member_ptr = ctx.createSoAFieldGEP(var, index_value, member_idx, member);
+                return ctx.getBuilder().CreateLoad(var.soa_record->getElementType(member_idx), member_ptr, member);
+            }
+            if (var) {
+                llvm::Type* array_type = var.type;
+                if (array_type->isArrayTy()) {
+                    llvm::Value* index_value = array_access->index->codegen(ctx);
+                    
+                    // Get array element pointer
+                    std::vector<llvm::Value*> indices;
+                    indices.push_back(llvm::ConstantInt::get(ctx.getContext(), llvm::APInt(32, 0)));
                     indices.push_back(index_value);
                     
                     llvm::Value* element_ptr = ctx.getBuilder().CreateGEP(
-                        array_type, alloca, indices, "arrayidx"
+                        array_type, var.ptr, indices, "arrayidx"
                     );
                     
                     // Get element type (should be struct)
@@ -609,11 +2698,8 @@ llvm::Value* MemberAccess::codegen(CodeGenContext& ctx) {
                         llvm::StructType* llvm_struct = llvm::cast<llvm::StructType>(element_type);
                         
                         // Find member index
-                        unsigned member_idx = 0;
-                        if (member == "x") member_idx = 0;
-                        else if (member == "y") member_idx = 1;
-                        else if (member == "z") member_idx = 2;
-                        else return nullptr;
+                        int member_idx = ctx.getMemberIndex(llvm_struct, member);
+                        if (member_idx < 0) return nullptr;
                         
                         // Get member pointer from array element
                         llvm::Value* member_ptr = ctx.getBuilder().CreateStructGEP(
@@ -622,7 +2708,10 @@ llvm::Value* MemberAccess::codegen(CodeGenContext& ctx) {
                         
                         // Load member value
                         llvm::Type* member_type = llvm_struct->getElementType(member_idx);
-                        return ctx.getBuilder().CreateLoad(member_type, member_ptr, member);
+                        llvm::Align element_align = llvm::commonAlignment(
+                            var.align, ctx.getModule()->getDataLayout().getTypeAllocSize(element_type));
+                        return ctx.getBuilder().CreateAlignedLoad(member_type, member_ptr,
+                                                                  ctx.getMemberAlign(llvm_struct, member_idx, element_align), member);
                     }
                 }
             }
@@ -635,21 +2724,30 @@ llvm::Value* MemberAccess::codegen(CodeGenContext& ctx) {
         return nullptr;
     }
     
-    unsigned member_idx = 0;
-    if (member == "x") member_idx = 0;
-    else if (member == "y") member_idx = 1;
-    else if (member == "z") member_idx = 2;
-    else return nullptr;
+    int member_idx = ctx.getMemberIndex(llvm::cast<llvm::StructType>(object_value->getType()), member);
+    if (member_idx < 0) return nullptr;
     
     return ctx.getBuilder().CreateExtractValue(object_value, member_idx, member);
 }
 
 llvm::Value* ArrayAccess::codegen(CodeGenContext& ctx) {
-    // Special handling: if array is Identifier, get its alloca
+    // Special handling: if array is Identifier, get its storage
     if (auto ident = dynamic_cast<Identifier*>(array.get())) {
-        llvm::AllocaInst* alloca = ctx.getAlloca(ident->name);
-        if (alloca) {
-            llvm::Type* array_type = alloca->getAllocatedType();
+        Variable var = ctx.getVariable(ident->name);
+        if (var && var.soa_record) {
+            return ctx.loadSoAElement(var, index->codegen(ctx));
+        }
+        if (var && var.olang_type.kind == TypeKind::SLICE) {
+            Type element_type;
+            llvm::Value* element_ptr = ctx.emitAddress(this, element_type);
+            if (!element_ptr) {
+                return nullptr;
+            }
+            return ctx.getBuilder().CreateAlignedLoad(ctx.getLLVMType(element_type), element_ptr,
+                                                      ctx.getTypeAlign(element_type), "sliceload");
+        }
+        if (var) {
+            llvm::Type* array_type = var.type;
             if (array_type->isArrayTy()) {
                 llvm::Value* index_value = index->codegen(ctx);
                 
@@ -659,7 +2757,7 @@ llvm::Value* ArrayAccess::codegen(CodeGenContext& ctx) {
                 indices.push_back(index_value);
                 
                 llvm::Value* element_ptr = ctx.getBuilder().CreateGEP(
-                    array_type, alloca, indices, "arrayidx"
+                    array_type, var.ptr, indices, "arrayidx"
                 );
                 
                 llvm::ArrayType* arr_type = llvm::cast<llvm::ArrayType>(array_type);
@@ -671,17 +2769,466 @@ llvm::Value* ArrayAccess::codegen(CodeGenContext& ctx) {
     return nullptr;
 }
 
+llvm::Function* CodeGenContext::outlineRange(const std::string& name,
+                                             const std::function<void(llvm::Value* lo, llvm::Value* hi)>& emit_body,
+                                             llvm::Value*& env) {
+    llvm::Function* parent = builder.GetInsertBlock()->getParent();
+    llvm::Type* i64_type = builder.getInt64Ty();
+    llvm::Type* ptr_type = llvm::PointerType::get(context, 0);
+    
+    // Visible locals, innermost declaration first (globals need no capture)
+    std::vector<std::pair<std::string, Variable>> captures;
+    std::unordered_map<std::string, bool> seen;
+    for (size_t scope = variable_table.size(); scope-- > 1;) {
+        for (const auto& entry : variable_table[scope]) {
+            if (seen.emplace(entry.first, true).second) {
+                captures.push_back(entry);
+            }
+        }
+    }
+    
+    env = llvm::ConstantPointerNull::get(llvm::PointerType::get(context, 0));
+    llvm::ArrayType* env_type = llvm::ArrayType::get(ptr_type, captures.size());
+    if (!captures.empty()) {
+        llvm::IRBuilder<> entry_builder(&parent->getEntryBlock(), parent->getEntryBlock().begin());
+        env = entry_builder.CreateAlloca(env_type, nullptr, name + ".env");
+        for (size_t i = 0; i < captures.size(); ++i) {
+            builder.CreateStore(captures[i].second.ptr, builder.CreateConstGEP2_32(env_type, env, 0, i));
+        }
+    }
+    
+    llvm::Function* function = llvm::Function::Create(
+        llvm::FunctionType::get(builder.getVoidTy(), {i64_type, i64_type, ptr_type}, false),
+        llvm::Function::InternalLinkage, parent->getName() + "." + name, module.get()
+    );
+    llvm::Value* lo = function->getArg(0);
+    llvm::Value* hi = function->getArg(1);
+    llvm::Value* env_arg = function->getArg(2);
+    lo->setName("lo");
+    hi->setName("hi");
+    env_arg->setName("env");
+    
+    llvm::IRBuilderBase::InsertPoint saved_ip = builder.saveIP();
+    builder.SetInsertPoint(llvm::BasicBlock::Create(context, "entry", function));
+    
+    // Rebind the captured names to the parent's storage
+    enterScope();
+    for (size_t i = 0; i < captures.size(); ++i) {
+        Variable var = captures[i].second;
+        var.ptr = builder.CreateLoad(ptr_type, builder.CreateConstGEP2_32(env_type, env_arg, 0, i),
+                                     captures[i].first + ".ref");
+        setVariable(captures[i].first, var);
+    }
+    
+    size_t cleanup_depth = getCleanupDepth();
+    outlined_depth++;
+    emit_body(lo, hi);
+    outlined_depth--;
+    exitScope();
+    
+    if (!builder.GetInsertBlock()->getTerminator()) {
+        emitCleanups(cleanup_depth);
+        builder.CreateRetVoid();
+    }
+    popCleanups(cleanup_depth);
+    builder.restoreIP(saved_ip);
+    return function;
+}
+
+llvm::Value* CodeGenContext::getTaskScope() {
+    llvm::Function* function = builder.GetInsertBlock()->getParent();
+    auto it = task_scopes.find(function);
+    if (it != task_scopes.end()) {
+        return it->second;
+    }
+    
+    llvm::PointerType* ptr_type = llvm::PointerType::get(context, 0);
+    llvm::IRBuilder<> entry_builder(&function->getEntryBlock(), function->getEntryBlock().begin());
+    llvm::AllocaInst* scope = entry_builder.CreateAlloca(ptr_type, nullptr, "task.scope");
+    entry_builder.CreateStore(llvm::ConstantPointerNull::get(ptr_type), scope);
+    task_scopes[function] = scope;
+    
+    // Returns emitted before the first spawn can still run after one (loops),
+    // so they sync too, ahead of any arena released on the way out; syncing
+    // an empty scope is a no-op
+    llvm::FunctionCallee sync = module->getOrInsertFunction(
+        "__olang_task_sync", llvm::FunctionType::get(builder.getVoidTy(), {ptr_type}, false)
+    );
+    for (llvm::BasicBlock& block : *function) {
+        if (auto ret = llvm::dyn_cast_or_null<llvm::ReturnInst>(block.getTerminator())) {
+            llvm::Instruction* insert_before = ret;
+            for (llvm::Instruction& inst : block) {
+                auto call = llvm::dyn_cast<llvm::CallInst>(&inst);
+                if (call && call->getCalledFunction() && call->getCalledFunction()->getName() == "__olang_arena_release") {
+                    insert_before = call;
+                    break;
+                }
+            }
+            llvm::CallInst::Create(sync, {scope}, "", insert_before);
+        }
+    }
+    pushCleanup([this, sync, scope]() {
+        builder.CreateCall(sync, {scope});
+    });
+    return scope;
+}
+
+llvm::Value* CodeGenContext::emitAddress(ASTNode* expr, Type& type) {
+    if (auto ident = dynamic_cast<Identifier*>(expr)) {
+        Variable var = getVariable(ident->name);
+        if (!var || var.soa_record) {
+            return nullptr;
+        }
+        type = var.olang_type;
+        return var.ptr;
+    }
+    if (auto array_access = dynamic_cast<ArrayAccess*>(expr)) {
+        Type array_type;
+        llvm::Value* array_ptr = emitAddress(array_access->array.get(), array_type);
+        if (array_ptr && array_type.kind == TypeKind::SLICE) {
+            llvm::Value* slice = builder.CreateLoad(getLLVMType(array_type), array_ptr, "slice");
+            type = *array_type.element_type;
+            return emitSliceElementAddress(slice, array_access->index->codegen(*this), type);
+        }
+        if (!array_ptr || array_type.kind != TypeKind::ARRAY) {
+            return nullptr;
+        }
+        llvm::Value* indices[] = {builder.getInt32(0), array_access->index->codegen(*this)};
+        type = *array_type.element_type;
+        return builder.CreateGEP(getLLVMType(array_type), array_ptr, indices, "arrayidx");
+    }
+    if (auto member_access = dynamic_cast<MemberAccess*>(expr)) {
+        Type struct_type;
+        llvm::Value* struct_ptr = emitAddress(member_access->object.get(), struct_type);
+        const StructInfo* info = struct_ptr && struct_type.kind == TypeKind::STRUCT ? getStructInfo(struct_type.name)
+                                                                                      : nullptr;
+        if (!info) {
+            return nullptr;
+        }
+        for (size_t i = 0; i < info->fields.size(); ++i) {
+            if (info->fields[i].second == member_access->member) {
+                type = info->fields[i].first;
+                return builder.CreateStructGEP(info->llvm_type, struct_ptr, info->field_index[i], member_access->member);
+            }
+        }
+        return nullptr;
+    }
+    if (auto unary = dynamic_cast<UnaryExpr*>(expr)) {
+        if (unary->op != UnaryExpr::DEREF) {
+            return nullptr;
+        }
+        Type pointer_type;
+        llvm::Value* pointer_ptr = emitAddress(unary->operand.get(), pointer_type);
+        if (!pointer_ptr || pointer_type.kind != TypeKind::POINTER) {
+            return nullptr;
+        }
+        type = *pointer_type.element_type;
+        return builder.CreateLoad(getLLVMType(pointer_type), pointer_ptr, "ptr");
+    }
+    return nullptr;
+}
+
+llvm::Value* CodeGenContext::emitSliceElementAddress(llvm::Value* slice, llvm::Value* index, const Type& element_type) {
+    if (!index) {
+        return nullptr;
+    }
+    llvm::Value* data = builder.CreateExtractValue(slice, 0, "slice.data");
+    index = convertIndex(index);
+    if (bounds_check) {
+        // Unsigned, so negative indices fail too; BoundsCheckElimPass drops the
+        // checks that loop conditions already guarantee
+        llvm::Value* length = builder.CreateExtractValue(slice, 1, "slice.len");
+        llvm::Function* function = builder.GetInsertBlock()->getParent();
+        llvm::BasicBlock* fail_block = llvm::BasicBlock::Create(context, "bounds.fail", function);
+        llvm::BasicBlock* ok_block = llvm::BasicBlock::Create(context, "bounds.ok", function);
+        builder.CreateCondBr(builder.CreateICmpULT(index, length, "in.bounds"), ok_block, fail_block);
+        
+        builder.SetInsertPoint(fail_block);
+        llvm::FunctionCallee fail = module->getOrInsertFunction(
+            BOUNDS_FAIL_FUNCTION,
+            llvm::FunctionType::get(builder.getVoidTy(), {builder.getInt64Ty(), builder.getInt64Ty()}, false)
+        );
+        if (auto* fail_function = llvm::dyn_cast<llvm::Function>(fail.getCallee())) {
+            fail_function->setDoesNotReturn();
+            fail_function->setDoesNotThrow();
+            fail_function->addFnAttr(llvm::Attribute::Cold);
+        }
+        builder.CreateCall(fail, {index, length});
+        builder.CreateUnreachable();
+        
+        builder.SetInsertPoint(ok_block);
+    }
+    return builder.CreateInBoundsGEP(getLLVMType(element_type), data, index, "slice.elem");
+}
+
+llvm::StructType* CodeGenContext::getSoAType(const Type& type) {
+    if (type.kind != TypeKind::ARRAY || type.element_type->kind != TypeKind::STRUCT) {
+        return nullptr;
+    }
+    const StructInfo* info = getStructInfo(type.element_type->name);
+    if (!info) {
+        return nullptr;
+    }
+    
+    // One column per record element; padding elements get empty columns
+    std::vector<bool> is_field(info->llvm_type->getNumElements(), false);
+    for (unsigned index : info->field_index) {
+        is_field[index] = true;
+    }
+    std::vector<llvm::Type*> columns;
+    for (unsigned i = 0; i < info->llvm_type->getNumElements(); ++i) {
+        columns.push_back(is_field[i] ? llvm::ArrayType::get(info->llvm_type->getElementType(i), type.array_size)
+                                      : llvm::ArrayType::get(llvm::Type::getInt8Ty(context), 0));
+    }
+    return llvm::StructType::get(context, columns);
+}
+
+llvm::Value* CodeGenContext::createSoAFieldGEP(const Variable& var, llvm::Value* index, unsigned member_idx,
+                                               const std::string& name) {
+    llvm::Value* indices[] = {
+        builder.getInt32(0), builder.getInt32(member_idx), index
+    };
+    return builder.CreateGEP(var.type, var.ptr, indices, name + ".soa");
+}
+
+llvm::Value* CodeGenContext::loadSoAElement(const Variable& var, llvm::Value* index) {
+    const StructInfo* info = getStructInfo(var.olang_type.element_type->name);
+    llvm::Value* element = llvm::PoisonValue::get(var.soa_record);
+    for (size_t i = 0; i < info->fields.size(); ++i) {
+        unsigned member_idx = info->field_index[i];
+        llvm::Value* member_ptr = createSoAFieldGEP(var, index, member_idx, info->fields[i].second);
+        llvm::Value* member = builder.CreateLoad(var.soa_record->getElementType(member_idx), member_ptr);
+        element = builder.CreateInsertValue(element, member, member_idx);
+    }
+    return element;
+}
+
+void CodeGenContext::storeSoAElement(const Variable& var, llvm::Value* index, llvm::Value* value) {
+    const StructInfo* info = getStructInfo(var.olang_type.element_type->name);
+    if (value->getType() != var.soa_record) {
+        error() << "storing a non-" << info->name << " value into an element of a #[soa] array\n";
+        return;
+    }
+    for (size_t i = 0; i < info->fields.size(); ++i) {
+        unsigned member_idx = info->field_index[i];
+        llvm::Value* member_ptr = createSoAFieldGEP(var, index, member_idx, info->fields[i].second);
+        builder.CreateStore(builder.CreateExtractValue(value, member_idx), member_ptr);
+    }
+}
+
+llvm::Value* CodeGenContext::convertValue(llvm::Value* value, llvm::Type* target) {
+    llvm::Type* source = value->getType();
+    if (source == target) {
+        return value;
+    }
+    auto* constant_int = llvm::dyn_cast<llvm::ConstantInt>(value);
+    if (constant_int && !source->isIntegerTy(1)) {
+        if (target->isIntegerTy() && !target->isIntegerTy(1)) {
+            unsigned target_bits = target->getIntegerBitWidth();
+            if (constant_int->getValue().isSignedIntN(target_bits)) {
+                return llvm::ConstantInt::get(target, constant_int->getSExtValue(), true);
+            }
+            error() << "integer literal " << constant_int->getSExtValue() << " does not fit in i" << target_bits
+                    << "\n";
+            return value;
+        }
+        if (target->isFloatingPointTy()) {
+            llvm::APFloat converted(target->getFltSemantics());
+            if (converted.convertFromAPInt(constant_int->getValue(), true, llvm::APFloat::rmNearestTiesToEven) ==
+                llvm::APFloat::opOK) {
+                return llvm::ConstantFP::get(target, converted);
+            }
+            error() << "integer literal " << constant_int->getSExtValue() << " is not exact as " << *target << "\n";
+            return value;
+        }
+        if (target->isPointerTy() && constant_int->isZero()) {
+            return llvm::ConstantPointerNull::get(llvm::cast<llvm::PointerType>(target));
+        }
+    }
+    // A float literal (always f64) rounds to a narrower type, as a C literal would
+    if (llvm::isa<llvm::ConstantFP>(value) && target->isFloatingPointTy()) {
+        return builder.CreateFPCast(value, target, "conv");
+    }
+    error() << "type mismatch: expected " << *target << ", got " << *source << "\n";
+    return value;
+}
+
+llvm::Value* CodeGenContext::convertIndex(llvm::Value* value) {
+    llvm::Type* i64_type = builder.getInt64Ty();
+    if (!value->getType()->isIntegerTy() || value->getType()->isIntegerTy(1)) {
+        error() << "expected an integer index, count or bound, got " << *value->getType() << "\n";
+        return value;
+    }
+    return builder.CreateSExtOrTrunc(value, i64_type, "idx");
+}
+
+llvm::Align CodeGenContext::getTypeAlign(const Type& type) {
+    if (type.kind == TypeKind::ARRAY) {
+        return getTypeAlign(*type.element_type);
+    }
+    if (type.kind == TypeKind::ATOMIC) {
+        // Atomic operations need natural alignment even where the ABI asks for less
+        return llvm::Align(llvm::PowerOf2Ceil(module->getDataLayout().getTypeStoreSize(getLLVMType(type))));
+    }
+    if (type.kind == TypeKind::STRUCT) {
+        if (const StructInfo* info = getStructInfo(type.name)) {
+            return info->align;
+        }
+    }
+    if (type.kind == TypeKind::CHAN) {
+        // tail and head each get a cache line
+        return std::max(llvm::Align(64), getTypeAlign(*type.element_type));
+    }
+    return module->getDataLayout().getABITypeAlign(getLLVMType(type));
+}
+
+llvm::Align CodeGenContext::getMemberAlign(llvm::StructType* struct_type, unsigned index, llvm::Align base_align) {
+    const llvm::StructLayout* layout = module->getDataLayout().getStructLayout(struct_type);
+    return llvm::commonAlignment(base_align, static_cast<uint64_t>(layout->getElementOffset(index)));
+}
+
+int CodeGenContext::getMemberIndex(llvm::StructType* struct_type, const std::string& member) {
+    for (const auto& entry : struct_infos) {
+        const StructInfo& info = entry.second;
+        if (info.llvm_type != struct_type) {
+            continue;
+        }
+        for (size_t i = 0; i < info.fields.size(); ++i) {
+            if (info.fields[i].second == member) {
+                return static_cast<int>(info.field_index[i]);
+            }
+        }
+        error() << "struct " << info.name << " has no field " << member << "\n";
+        return -1;
+    }
+    return -1;
+}
+
+void CodeGenContext::instrumentFunctionEntry(const std::string& name) {
+    llvm::Type* i64_type = llvm::Type::getInt64Ty(context);
+    llvm::Type* ptr_type = llvm::PointerType::get(context, 0);
+    
+    // Per-function record, laid out as struct olang_prof_record in runtime/olang_prof.c.
+    // All records land in the "olang_prof" section so the runtime can walk them
+    // through the linker-provided __start_/__stop_ symbols.
+    llvm::StructType* record_type = llvm::StructType::getTypeByName(context, "olang.prof_record");
+    if (!record_type) {
+        record_type = llvm::StructType::create(context, {i64_type, i64_type, ptr_type}, "olang.prof_record");
+    }
+    
+    llvm::Constant* name_str = builder.CreateGlobalStringPtr(name, "prof.name");
+    llvm::Constant* init = llvm::ConstantStruct::get(record_type, {
+        llvm::ConstantInt::get(i64_type, 0),
+        llvm::ConstantInt::get(i64_type, 0),
+        name_str
+    });
+    
+    auto record = new llvm::GlobalVariable(
+        *module, record_type, false, llvm::GlobalValue::InternalLinkage, init, "__olang_prof." + name
+    );
+    record->setSection("olang_prof");
+    record->setAlignment(llvm::Align(8));
+    llvm::appendToUsed(*module, {record});
+    
+    addRuntimeInit("__olang_prof_init");
+    
+    // Count the call
+    llvm::Value* calls_ptr = builder.CreateStructGEP(record_type, record, 0, "prof.calls");
+    builder.CreateAtomicRMW(llvm::AtomicRMWInst::Add, calls_ptr, llvm::ConstantInt::get(i64_type, 1),
+                            llvm::MaybeAlign(8), llvm::AtomicOrdering::Monotonic);
+    
+    if (instrument_mode != InstrumentMode::TIMING) {
+        return;
+    }
+    
+    // Accumulate elapsed cycles on every return path
+    llvm::Function* rdtsc = llvm::Intrinsic::getDeclaration(module.get(), llvm::Intrinsic::readcyclecounter);
+    llvm::Value* start = builder.CreateCall(rdtsc, {}, "prof.start");
+    pushCleanup([this, rdtsc, start, record_type, record, i64_type]() {
+        llvm::Value* end = builder.CreateCall(rdtsc, {}, "prof.end");
+        llvm::Value* elapsed = builder.CreateSub(end, start, "prof.elapsed");
+        llvm::Value* cycles_ptr = builder.CreateStructGEP(record_type, record, 1, "prof.cycles");
+        builder.CreateAtomicRMW(llvm::AtomicRMWInst::Add, cycles_ptr, elapsed,
+                                llvm::MaybeAlign(8), llvm::AtomicOrdering::Monotonic);
+    });
+}
+
+llvm::Function* CodeGenContext::getHeapProfileHook(llvm::Function* callee) {
+    if (!callee->isDeclaration()) {
+        return nullptr;
+    }
+    llvm::StringRef name = callee->getName();
+    if (name != "malloc" && name != "calloc" && name != "realloc" && name != "free") {
+        return nullptr;
+    }
+    
+    addRuntimeInit("__olang_heap_init");
+    
+    // Same signature as the extern plus the call site name
+    std::vector<llvm::Type*> param_types(callee->getFunctionType()->param_begin(),
+                                         callee->getFunctionType()->param_end());
+    param_types.push_back(llvm::PointerType::get(context, 0));
+    llvm::FunctionType* hook_type = llvm::FunctionType::get(callee->getReturnType(), param_types, false);
+    llvm::FunctionCallee hook = module->getOrInsertFunction("__olang_heap_" + name.str(), hook_type);
+    return llvm::dyn_cast<llvm::Function>(hook.getCallee());
+}
+
+void CodeGenContext::emitBenchDriver(const std::vector<llvm::Function*>& benches) {
+    llvm::Type* i32_type = llvm::Type::getInt32Ty(context);
+    llvm::Type* i64_type = llvm::Type::getInt64Ty(context);
+    llvm::Type* ptr_type = llvm::PointerType::get(context, 0);
+    
+    llvm::Function* main_function = llvm::Function::Create(
+        llvm::FunctionType::get(i32_type, false), llvm::Function::ExternalLinkage, "main", module.get()
+    );
+    builder.SetInsertPoint(llvm::BasicBlock::Create(context, "entry", main_function));
+    
+    // { name, fn } table, laid out as struct olang_bench in runtime/olang_bench.c
+    llvm::StructType* entry_type = llvm::StructType::create(context, {ptr_type, ptr_type}, "olang.bench");
+    std::vector<llvm::Constant*> entries;
+    for (llvm::Function* bench : benches) {
+        entries.push_back(llvm::ConstantStruct::get(entry_type, {
+            builder.CreateGlobalStringPtr(bench->getName(), "bench.name"), bench
+        }));
+    }
+    llvm::ArrayType* table_type = llvm::ArrayType::get(entry_type, entries.size());
+    auto table = new llvm::GlobalVariable(
+        *module, table_type, true, llvm::GlobalValue::InternalLinkage,
+        llvm::ConstantArray::get(table_type, entries), "olang.benches"
+    );
+    
+    llvm::FunctionCallee run = module->getOrInsertFunction(
+        "__olang_bench_main", llvm::FunctionType::get(i32_type, {ptr_type, i64_type}, false)
+    );
+    llvm::Value* status = builder.CreateCall(run, {table, llvm::ConstantInt::get(i64_type, entries.size())});
+    builder.CreateRet(status);
+}
+
+void CodeGenContext::addRuntimeInit(const std::string& init_name) {
+    for (const auto& registered : runtime_inits) {
+        if (registered == init_name) {
+            return;
+        }
+    }
+    runtime_inits.push_back(init_name);
+    
+    llvm::FunctionType* init_type = llvm::FunctionType::get(llvm::Type::getVoidTy(context), false);
+    llvm::FunctionCallee init = module->getOrInsertFunction(init_name, init_type);
+    llvm::appendToGlobalCtors(*module, llvm::cast<llvm::Function>(init.getCallee()), 65535);
+}
+
 void CodeGenContext::setTargetTriple(const std::string& triple) {
     module->setTargetTriple(triple);
 }
 
-bool CodeGenContext::emitObjectFile(const std::string& filename, const std::string& target_triple) {
+bool CodeGenContext::initTarget(const std::string& target_triple) {
     // Only initialize native target (avoid linking all architecture libraries)
     llvm::InitializeNativeTarget();
     llvm::InitializeNativeTargetAsmParser();
     llvm::InitializeNativeTargetAsmPrinter();
     
-    // Get target triple
+    // Set before codegen: struct layout and alignment decisions depend on the
+    // target, so even --emit-llvm output carries its triple and DataLayout
     std::string triple = target_triple.empty() ? 
         llvm::sys::getDefaultTargetTriple() : target_triple;
     module->setTargetTriple(triple);
@@ -698,11 +3245,65 @@ bool CodeGenContext::emitObjectFile(const std::string& filename, const std::stri
     auto features = "";
     
     llvm::TargetOptions opt;
-    auto target_machine = target->createTargetMachine(
+    opt.EmitStackSizeSection = size_report;  // .stack_sizes feeds the size report
+    target_machine.reset(target->createTargetMachine(
         triple, cpu, features, opt, llvm::Reloc::PIC_
-    );
+    ));
     
     module->setDataLayout(target_machine->createDataLayout());
+    return true;
+}
+
+void CodeGenContext::optimize() {
+    llvm::LoopAnalysisManager loop_analyses;
+    llvm::FunctionAnalysisManager function_analyses;
+    llvm::CGSCCAnalysisManager cgscc_analyses;
+    llvm::ModuleAnalysisManager module_analyses;
+    llvm::PassBuilder pass_builder(target_machine.get());
+    pass_builder.registerModuleAnalyses(module_analyses);
+    pass_builder.registerCGSCCAnalyses(cgscc_analyses);
+    pass_builder.registerFunctionAnalyses(function_analyses);
+    pass_builder.registerLoopAnalyses(loop_analyses);
+    pass_builder.crossRegisterProxies(loop_analyses, function_analyses, cgscc_analyses, module_analyses);
+    
+    // Before inlining and coroutine splitting, while every call of a channel
+    // operation is still in the function that wrote it
+    pass_builder.registerPipelineStartEPCallback([](llvm::ModulePassManager& module_passes, llvm::OptimizationLevel) {
+        module_passes.addPass(SpscChannelPass());
+    });
+    
+    // Heap-to-stack runs at every peephole point, so it also sees calls that
+    // became constant-sized (and pointers that became provably local) after
+    // inlining; the SROA and DSE runs that follow clean up the allocas
+    if (opt_level > 0) {
+        pass_builder.registerPeepholeEPCallback([](llvm::FunctionPassManager& function_passes, llvm::OptimizationLevel) {
+            function_passes.addPass(HeapToStackPass());
+        });
+    }
+    
+    // The first peephole point precedes loop rotation, so a bounds check in a
+    // loop body is still dominated by the loop condition it is compared with
+    if (opt_level > 0 && bounds_check) {
+        pass_builder.registerPeepholeEPCallback([](llvm::FunctionPassManager& function_passes, llvm::OptimizationLevel) {
+            function_passes.addPass(BoundsCheckElimPass());
+        });
+    }
+    
+    // Both pipelines include the coroutine passes (CoroEarly, CoroSplit, CoroElide, CoroCleanup)
+    llvm::ModulePassManager passes;
+    switch (opt_level) {
+        case 0: passes = pass_builder.buildO0DefaultPipeline(llvm::OptimizationLevel::O0); break;
+        case 1: passes = pass_builder.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O1); break;
+        case 2: passes = pass_builder.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O2); break;
+        default: passes = pass_builder.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O3); break;
+    }
+    passes.run(*module, module_analyses);
+}
+
+bool CodeGenContext::emitObjectFile(const std::string& filename, const std::string& target_triple) {
+    if (!target_machine && !initTarget(target_triple)) {
+        return false;
+    }
     
     // Open file
     std::error_code EC;
@@ -713,18 +3314,25 @@ bool CodeGenContext::emitObjectFile(const std::string& filename, const std::stri
         return false;
     }
     
-    // Generate object file
+    // Generate object file (into memory, so the reports can inspect it)
+    llvm::SmallVector<char, 0> object_buffer;
+    llvm::raw_svector_ostream object_stream(object_buffer);
     llvm::legacy::PassManager pass;
     auto file_type = llvm::CodeGenFileType::ObjectFile;
     
-    if (target_machine->addPassesToEmitFile(pass, dest, nullptr, file_type)) {
+    if (target_machine->addPassesToEmitFile(pass, object_stream, nullptr, file_type)) {
         llvm::errs() << "TargetMachine can't emit a file of this type";
         return false;
     }
     
     pass.run(*module);
+    dest.write(object_buffer.data(), object_buffer.size());
     dest.flush();
     
+    if (size_report) {
+        printSizeReport(llvm::StringRef(object_buffer.data(), object_buffer.size()));
+    }
+    
     return true;
 }
 
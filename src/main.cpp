@@ -81,6 +81,20 @@ int main(int argc, char* argv[]) {
         std::cerr << "  -o <output>       Specify output file" << std::endl;
         std::cerr << "  --target <triple> Specify target triple" << std::endl;
         std::cerr << "  --print-ir        Print LLVM IR to stdout" << std::endl;
+        std::cerr << "  --instrument-functions=counts|timing" << std::endl;
+        std::cerr << "                    Count calls (and rdtsc cycles) per function" << std::endl;
+        std::cerr << "  --xray            Emit XRay entry/exit sleds (toggled at run time)" << std::endl;
+        std::cerr << "  --xray-threshold=<n>" << std::endl;
+        std::cerr << "                    Minimum instructions for a function to get sleds (default 200)" << std::endl;
+        std::cerr << "  --bench           Compile bench fns with a benchmark driver as main" << std::endl;
+        std::cerr << "  --heap-profile    Profile malloc/calloc/realloc/free calls" << std::endl;
+        std::cerr << "  --size-report     Print per-function code size and stack frame size" << std::endl;
+        std::cerr << "  --layout-report   Print struct layouts with padding and cache-line analysis" << std::endl;
+        std::cerr << "  --layout-waste=<fraction>" << std::endl;
+        std::cerr << "                    Padding fraction flagged by the layout report (default 0.25)" << std::endl;
+        std::cerr << "  --reorder-fields  Reorder fields of internal structs to minimize padding" << std::endl;
+        std::cerr << "  --bounds-check    Check slice indices (provably redundant checks are removed at -O1+)" << std::endl;
+        std::cerr << "  -O0 .. -O3        Optimization level (default -O0)" << std::endl;
         std::cerr << "" << std::endl;
         std::cerr << "Default: Generate object file (.o)" << std::endl;
         std::cerr << "Linking: Use ld.lld or clang to link .o files" << std::endl;
@@ -92,6 +106,17 @@ int main(int argc, char* argv[]) {
     std::string target_triple = "";
     bool emit_llvm = false;
     bool print_ir = false;
+    olang::InstrumentMode instrument_mode = olang::InstrumentMode::NONE;
+    bool xray = false;
+    int xray_threshold = 200;
+    bool bench = false;
+    bool heap_profile = false;
+    bool size_report = false;
+    bool layout_report = false;
+    double layout_waste = 0.25;
+    bool reorder_fields = false;
+    bool bounds_check = false;
+    int opt_level = 0;
     
     // Parse arguments
     for (int i = 2; i < argc; i++) {
@@ -104,6 +129,42 @@ int main(int argc, char* argv[]) {
             target_triple = argv[++i];
         } else if (arg == "--print-ir") {
             print_ir = true;
+        } else if (arg.rfind("--instrument-functions=", 0) == 0) {
+            std::string mode = arg.substr(arg.find('=') + 1);
+            if (mode == "counts") {
+                instrument_mode = olang::InstrumentMode::COUNTS;
+            } else if (mode == "timing") {
+                instrument_mode = olang::InstrumentMode::TIMING;
+            } else {
+                std::cerr << "Error: Unknown instrumentation mode: " << mode << std::endl;
+                return 1;
+            }
+        } else if (arg == "--xray") {
+            xray = true;
+        } else if (arg.rfind("--xray-threshold=", 0) == 0) {
+            xray = true;
+            xray_threshold = std::atoi(arg.substr(arg.find('=') + 1).c_str());
+            if (xray_threshold <= 0) {
+                std::cerr << "Error: Invalid XRay threshold: " << arg << std::endl;
+                return 1;
+            }
+        } else if (arg == "--bench") {
+            bench = true;
+        } else if (arg == "--heap-profile") {
+            heap_profile = true;
+        } else if (arg == "--size-report") {
+            size_report = true;
+        } else if (arg == "--layout-report") {
+            layout_report = true;
+        } else if (arg.rfind("--layout-waste=", 0) == 0) {
+            layout_report = true;
+            layout_waste = std::atof(arg.substr(arg.find('=') + 1).c_str());
+        } else if (arg == "--reorder-fields") {
+            reorder_fields = true;
+        } else if (arg == "--bounds-check") {
+            bounds_check = true;
+        } else if (arg == "-O0" || arg == "-O1" || arg == "-O2" || arg == "-O3") {
+            opt_level = arg[2] - '0';
         }
     }
     
@@ -162,13 +223,34 @@ int main(int argc, char* argv[]) {
         // Create code generation context
         llvm::LLVMContext context;
         olang::CodeGenContext codegen_ctx(context);
+        codegen_ctx.setInstrumentMode(instrument_mode);
+        if (xray) {
+            codegen_ctx.setXRayThreshold(xray_threshold);
+        }
+        codegen_ctx.setBenchMode(bench);
+        codegen_ctx.setHeapProfile(heap_profile);
+        codegen_ctx.setSizeReport(size_report);
+        codegen_ctx.setLayoutReport(layout_report, layout_waste);
+        codegen_ctx.setReorderFields(reorder_fields);
+        codegen_ctx.setOptLevel(opt_level);
+        codegen_ctx.setBoundsCheck(bounds_check);
+        
+        // Target DataLayout is needed during codegen (struct layout decisions)
+        if (!codegen_ctx.initTarget(target_triple)) {
+            std::cerr << "Failed to initialize target!" << std::endl;
+            return 1;
+        }
         
         // Generate LLVM IR
         program_node->codegen(codegen_ctx);
         
-        // Set target triple if specified
-        if (!target_triple.empty()) {
-            codegen_ctx.setTargetTriple(target_triple);
+        if (codegen_ctx.getErrorCount() > 0) {
+            std::cerr << "Code generation failed with " << codegen_ctx.getErrorCount() << " error(s)!" << std::endl;
+            return 1;
+        }
+        
+        if (codegen_ctx.isLayoutReport()) {
+            codegen_ctx.printLayoutReport();
         }
         
         // Optional: print IR to stdout
@@ -182,6 +264,9 @@ int main(int argc, char* argv[]) {
             return 1;
         }
         
+        // -O pipeline (at -O0 just the mandatory passes, e.g. coroutine lowering)
+        codegen_ctx.optimize();
+        
         // Output different formats based on options
         if (emit_llvm) {
             // Output LLVM IR
@@ -0,0 +1,462 @@
+#include "passes.h"
+#include <llvm/ADT/MapVector.h>
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Analysis/ScalarEvolution.h>
+#include <llvm/Analysis/ValueTracking.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Operator.h>
+#include <utility>
+
+namespace olang {
+
+namespace {
+
+// Largest single allocation moved to the stack, and the most a function's
+// frame may grow by: recursive functions pay it on every level
+const uint64_t MAX_PROMOTED_SIZE = 1024;
+const uint64_t MAX_PROMOTED_FRAME = 4096;
+
+// Name of the allocas the pass creates (SROA keeps it as a prefix when it
+// splits one), so later runs charge them to the frame budget
+const char PROMOTED_NAME[] = ".stack";
+
+// Bytes of the function's frame already promoted, by this or an earlier run:
+// the pass runs at every peephole point
+uint64_t getPromotedBytes(llvm::Function& function) {
+    const llvm::DataLayout& layout = function.getParent()->getDataLayout();
+    uint64_t bytes = 0;
+    for (llvm::Instruction& instruction : function.getEntryBlock()) {
+        auto* alloca = llvm::dyn_cast<llvm::AllocaInst>(&instruction);
+        if (alloca && alloca->isStaticAlloca() && alloca->getName().contains(PROMOTED_NAME)) {
+            bytes += layout.getTypeAllocSize(alloca->getAllocatedType());
+        }
+    }
+    return bytes;
+}
+
+// malloc's 16-byte guarantee, which callers may rely on
+const llvm::Align MALLOC_ALIGN(16);
+
+// A call to the libc.olang malloc(size) or calloc(count, size) extern with
+// a constant size; returns the size in bytes, or 0
+uint64_t getPromotableSize(llvm::CallInst* call) {
+    llvm::Function* callee = call->getCalledFunction();
+    if (!callee || !callee->isDeclaration() || !call->getType()->isPointerTy()) {
+        return 0;
+    }
+    llvm::StringRef name = callee->getName();
+    if (name == "malloc" && call->arg_size() == 1) {
+        auto* size = llvm::dyn_cast<llvm::ConstantInt>(call->getArgOperand(0));
+        return size && size->getValue().ule(MAX_PROMOTED_SIZE) ? size->getZExtValue() : 0;
+    }
+    if (name == "calloc" && call->arg_size() == 2) {
+        auto* count = llvm::dyn_cast<llvm::ConstantInt>(call->getArgOperand(0));
+        auto* size = llvm::dyn_cast<llvm::ConstantInt>(call->getArgOperand(1));
+        if (!count || !size || count->getValue().ugt(MAX_PROMOTED_SIZE) || size->getValue().ugt(MAX_PROMOTED_SIZE)) {
+            return 0;
+        }
+        uint64_t bytes = count->getZExtValue() * size->getZExtValue();
+        return bytes <= MAX_PROMOTED_SIZE ? bytes : 0;
+    }
+    return 0;
+}
+
+bool isFreeOf(llvm::CallBase* call, llvm::Value* pointer) {
+    llvm::Function* callee = call->getCalledFunction();
+    return callee && callee->isDeclaration() && callee->getName() == "free" &&
+           call->arg_size() == 1 && call->getArgOperand(0) == pointer && call->use_empty();
+}
+
+// Follows every use of the allocation and of pointers derived from it.
+// Fails if the memory may outlive the function or be freed other than by a
+// direct free(allocation): the pointer is stored, returned, merged through a
+// phi or select, converted to an integer, or passed to a call that may keep
+// or free it.
+bool collectFrees(llvm::CallInst* allocation, llvm::SmallVectorImpl<llvm::CallBase*>& frees) {
+    llvm::SmallVector<llvm::Value*, 8> worklist{allocation};
+    llvm::SmallPtrSet<llvm::Value*, 8> visited{allocation};
+    while (!worklist.empty()) {
+        llvm::Value* pointer = worklist.pop_back_val();
+        for (llvm::Use& use : pointer->uses()) {
+            auto* user = llvm::cast<llvm::Instruction>(use.getUser());
+            if (llvm::isa<llvm::GetElementPtrInst>(user) || llvm::isa<llvm::BitCastInst>(user)) {
+                if (visited.insert(user).second) {
+                    worklist.push_back(user);
+                }
+            } else if (llvm::isa<llvm::LoadInst>(user)) {
+                // Reads through the pointer
+            } else if (auto* store = llvm::dyn_cast<llvm::StoreInst>(user)) {
+                if (store->getValueOperand() == pointer) {
+                    return false;
+                }
+            } else if (llvm::isa<llvm::ICmpInst>(user)) {
+                // Null checks fold away once the pointer is an alloca
+            } else if (auto* call = llvm::dyn_cast<llvm::CallBase>(user)) {
+                if (isFreeOf(call, allocation)) {
+                    frees.push_back(call);
+                    continue;
+                }
+                if (llvm::isa<llvm::MemIntrinsic>(call) || call->isLifetimeStartOrEnd()) {
+                    continue;
+                }
+                if (!call->isArgOperand(&use)) {
+                    return false;
+                }
+                unsigned arg = call->getArgOperandNo(&use);
+                bool keeps = !call->doesNotCapture(arg) || call->paramHasAttr(arg, llvm::Attribute::Returned);
+                bool frees_it = !call->hasFnAttr(llvm::Attribute::NoFree) && !call->paramHasAttr(arg, llvm::Attribute::NoFree);
+                if (keeps || frees_it) {
+                    return false;
+                }
+            } else {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// i <s n at context: proven by scalar evolution, or by a dominating test
+// i < m (or i <= m) with m <= n (m < n) known where it is made, as when the
+// loop runs to a bound that was itself checked against the length
+bool isSignedBelowAt(llvm::ScalarEvolution& scev, llvm::DominatorTree& dominators, const llvm::SCEV* index,
+                     const llvm::SCEV* length, llvm::Instruction* context) {
+    if (scev.isKnownPredicateAt(llvm::ICmpInst::ICMP_SLT, index, length, context)) {
+        return true;
+    }
+    for (llvm::DomTreeNode* node = dominators.getNode(context->getParent()); node && node->getIDom();
+         node = node->getIDom()) {
+        llvm::BasicBlock* dominator = node->getIDom()->getBlock();
+        auto* branch = llvm::dyn_cast<llvm::BranchInst>(dominator->getTerminator());
+        auto* compare = branch && branch->isConditional() ? llvm::dyn_cast<llvm::ICmpInst>(branch->getCondition())
+                                                          : nullptr;
+        if (!compare || !scev.isSCEVable(compare->getOperand(0)->getType())) {
+            continue;
+        }
+        llvm::ICmpInst::Predicate pred = compare->getPredicate();
+        if (dominators.dominates(llvm::BasicBlockEdge(dominator, branch->getSuccessor(1)), node->getBlock())) {
+            pred = compare->getInversePredicate();
+        } else if (!dominators.dominates(llvm::BasicBlockEdge(dominator, branch->getSuccessor(0)), node->getBlock())) {
+            continue;
+        }
+        const llvm::SCEV* left = scev.getSCEV(compare->getOperand(0));
+        const llvm::SCEV* right = scev.getSCEV(compare->getOperand(1));
+        if (right == index) {
+            std::swap(left, right);
+            pred = llvm::ICmpInst::getSwappedPredicate(pred);
+        }
+        if (left != index) {
+            continue;
+        }
+        if ((pred == llvm::ICmpInst::ICMP_SLT && scev.isKnownPredicateAt(llvm::ICmpInst::ICMP_SLE, right, length, branch)) ||
+            (pred == llvm::ICmpInst::ICMP_SLE && scev.isKnownPredicateAt(llvm::ICmpInst::ICMP_SLT, right, length, branch))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// pred(lhs, rhs) holds at context. Beyond what scalar evolution proves
+// directly, i <u n also follows from 0 <= i and i <s n: loop conditions are
+// signed, the checks unsigned.
+bool isKnownAt(llvm::ScalarEvolution& scev, llvm::DominatorTree& dominators, llvm::ICmpInst::Predicate pred,
+               llvm::Value* lhs, llvm::Value* rhs, llvm::Instruction* context) {
+    if (!scev.isSCEVable(lhs->getType())) {
+        return false;
+    }
+    const llvm::SCEV* left = scev.getSCEV(lhs);
+    const llvm::SCEV* right = scev.getSCEV(rhs);
+    if (pred == llvm::ICmpInst::ICMP_UGT) {
+        std::swap(left, right);
+        pred = llvm::ICmpInst::ICMP_ULT;
+    }
+    if (scev.isKnownPredicateAt(pred, left, right, context)) {
+        return true;
+    }
+    return pred == llvm::ICmpInst::ICMP_ULT &&
+           scev.isKnownPredicateAt(llvm::ICmpInst::ICMP_SGE, left, scev.getZero(left->getType()), context) &&
+           isSignedBelowAt(scev, dominators, left, right, context);
+}
+
+// Spawns function as a task (runtime/olang_task.c): call passes it as the thunk
+bool isTaskSpawn(llvm::CallBase* call, llvm::Function* function) {
+    llvm::Function* callee = call->getCalledFunction();
+    return callee && callee->getName() == "__olang_task_spawn" && call->arg_size() == 3 &&
+           call->getArgOperand(1) == function;
+}
+
+// block may run more than once per call of its function: it is on a cycle
+bool isInCycle(llvm::BasicBlock* block) {
+    llvm::SmallVector<llvm::BasicBlock*, 16> worklist(llvm::succ_begin(block), llvm::succ_end(block));
+    llvm::SmallPtrSet<llvm::BasicBlock*, 16> visited;
+    while (!worklist.empty()) {
+        llvm::BasicBlock* next = worklist.pop_back_val();
+        if (next == block) {
+            return true;
+        }
+        if (visited.insert(next).second) {
+            worklist.append(llvm::succ_begin(next), llvm::succ_end(next));
+        }
+    }
+    return false;
+}
+
+// Adds to entries the functions that start the threads function may run on:
+// main, and the thunks of spawned tasks. False if function can be reached
+// some other way: it or a caller is exported (callable from C), or has its
+// address taken (a callback, a parallel for body).
+bool collectEntries(llvm::Function* function, llvm::SmallPtrSetImpl<llvm::Function*>& visited,
+                    llvm::SmallPtrSetImpl<llvm::Function*>& entries) {
+    if (!visited.insert(function).second) {
+        return true;
+    }
+    if (function->getName() == "main") {
+        entries.insert(function);
+    } else if (!function->hasLocalLinkage()) {
+        return false;
+    }
+    for (llvm::Use& use : function->uses()) {
+        auto* call = llvm::dyn_cast<llvm::CallBase>(use.getUser());
+        if (call && isTaskSpawn(call, function)) {
+            entries.insert(function);
+        } else if (!call || !call->isCallee(&use) || !collectEntries(call->getFunction(), visited, entries)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// function starts at most once per run: main, or an internal function (or
+// task thunk) called (spawned) from one place, outside any loop, of a
+// function that itself starts at most once
+bool runsOnce(llvm::Function* function) {
+    llvm::SmallPtrSet<llvm::Function*, 8> visited;
+    while (function->getName() != "main") {
+        if (!function->hasLocalLinkage() || !function->hasOneUse() || !visited.insert(function).second) {
+            return false;
+        }
+        llvm::Use& use = *function->use_begin();
+        auto* call = llvm::dyn_cast<llvm::CallBase>(use.getUser());
+        if (!call || !(call->isCallee(&use) || isTaskSpawn(call, function)) || isInCycle(call->getParent())) {
+            return false;
+        }
+        function = call->getFunction();
+    }
+    return function->use_empty();
+}
+
+// One thread at a time runs the claims: they are all reachable only from
+// the same entry, which starts once
+bool isSingleThreaded(llvm::ArrayRef<llvm::AtomicCmpXchgInst*> claims) {
+    llvm::SmallPtrSet<llvm::Function*, 8> visited;
+    llvm::SmallPtrSet<llvm::Function*, 2> entries;
+    for (llvm::AtomicCmpXchgInst* claim : claims) {
+        if (!collectEntries(claim->getFunction(), visited, entries) || entries.size() > 1) {
+            return false;
+        }
+    }
+    return entries.empty() || runsOnce(*entries.begin());
+}
+
+// Nothing but the channel operations the compiler emitted can reach chan:
+// an internal global whose address is only loaded from, stored to, indexed
+// or passed to the runtime's __olang_chan_* functions
+bool isPrivateChannel(llvm::GlobalVariable* chan) {
+    if (!chan->hasLocalLinkage() || chan->isThreadLocal()) {
+        return false;
+    }
+    llvm::SmallVector<llvm::Value*, 8> worklist{chan};
+    llvm::SmallPtrSet<llvm::Value*, 16> visited{chan};
+    while (!worklist.empty()) {
+        llvm::Value* pointer = worklist.pop_back_val();
+        for (llvm::User* user : pointer->users()) {
+            if (llvm::isa<llvm::GEPOperator>(user)) {
+                if (visited.insert(user).second) {
+                    worklist.push_back(user);
+                }
+                continue;
+            }
+            if (llvm::isa<llvm::LoadInst>(user)) {
+                continue;
+            }
+            if (auto* store = llvm::dyn_cast<llvm::StoreInst>(user)) {
+                if (store->getValueOperand() == pointer) {
+                    return false;
+                }
+                continue;
+            }
+            if (auto* exchange = llvm::dyn_cast<llvm::AtomicCmpXchgInst>(user)) {
+                if (exchange->getPointerOperand() != pointer) {
+                    return false;
+                }
+                continue;
+            }
+            auto* call = llvm::dyn_cast<llvm::CallBase>(user);
+            llvm::Function* callee = call ? call->getCalledFunction() : nullptr;
+            if (!callee || !callee->getName().startswith("__olang_chan_") || call->getArgOperand(0) != pointer) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Replaces the claim with a store of its new value; with no other thread on
+// this side of the channel it always succeeds
+void claimWithStore(llvm::AtomicCmpXchgInst* claim) {
+    llvm::IRBuilder<> builder(claim);
+    llvm::StoreInst* store = builder.CreateAlignedStore(claim->getNewValOperand(), claim->getPointerOperand(), claim->getAlign());
+    store->setAtomic(llvm::AtomicOrdering::Monotonic);
+    llvm::Value* result = builder.CreateInsertValue(llvm::PoisonValue::get(claim->getType()), claim->getCompareOperand(), 0);
+    result = builder.CreateInsertValue(result, builder.getTrue(), 1);
+    claim->replaceAllUsesWith(result);
+    claim->eraseFromParent();
+}
+
+} // namespace
+
+llvm::PreservedAnalyses HeapToStackPass::run(llvm::Function& function, llvm::FunctionAnalysisManager&) {
+    llvm::SmallVector<std::pair<llvm::CallInst*, uint64_t>, 4> candidates;
+    for (llvm::BasicBlock& block : function) {
+        for (llvm::Instruction& instruction : block) {
+            if (auto* call = llvm::dyn_cast<llvm::CallInst>(&instruction)) {
+                if (uint64_t size = getPromotableSize(call)) {
+                    candidates.push_back({call, size});
+                }
+            }
+        }
+    }
+    if (candidates.empty()) {
+        return llvm::PreservedAnalyses::all();
+    }
+
+    const llvm::DataLayout& layout = function.getParent()->getDataLayout();
+    llvm::BasicBlock& entry = function.getEntryBlock();
+    uint64_t promoted_bytes = getPromotedBytes(function);
+    bool changed = false;
+    for (auto [call, size] : candidates) {
+        llvm::SmallVector<llvm::CallBase*, 4> frees;
+        if (promoted_bytes + size > MAX_PROMOTED_FRAME || !collectFrees(call, frees)) {
+            continue;
+        }
+        promoted_bytes += size;
+
+        // One slot serves every execution of the call (in a loop, say): only
+        // the latest result is reachable, so earlier ones are dead
+        llvm::IRBuilder<> builder(&entry, entry.getFirstInsertionPt());
+        llvm::AllocaInst* slot = builder.CreateAlloca(
+            llvm::ArrayType::get(builder.getInt8Ty(), size), layout.getAllocaAddrSpace(), nullptr,
+            call->getName() + PROMOTED_NAME
+        );
+        slot->setAlignment(MALLOC_ALIGN);
+        if (call->getCalledFunction()->getName() == "calloc") {
+            builder.SetInsertPoint(call);
+            builder.CreateMemSet(slot, builder.getInt8(0), size, MALLOC_ALIGN);
+        }
+        call->replaceAllUsesWith(slot);
+        call->eraseFromParent();
+        for (llvm::CallBase* free_call : frees) {
+            free_call->eraseFromParent();
+        }
+        changed = true;
+    }
+    if (!changed) {
+        return llvm::PreservedAnalyses::all();
+    }
+    llvm::PreservedAnalyses preserved;
+    preserved.preserveSet<llvm::CFGAnalyses>();
+    return preserved;
+}
+
+llvm::PreservedAnalyses BoundsCheckElimPass::run(llvm::Function& function, llvm::FunctionAnalysisManager& analyses) {
+    llvm::Function* fail = function.getParent()->getFunction(BOUNDS_FAIL_FUNCTION);
+    if (!fail) {
+        return llvm::PreservedAnalyses::all();
+    }
+
+    llvm::ScalarEvolution* scev = nullptr;
+    llvm::DominatorTree* dominators = nullptr;
+    bool changed = false;
+    for (llvm::User* user : fail->users()) {
+        auto* call = llvm::dyn_cast<llvm::CallInst>(user);
+        if (!call || call->getFunction() != &function) {
+            continue;
+        }
+        llvm::BasicBlock* fail_block = call->getParent();
+        for (llvm::BasicBlock* predecessor : llvm::predecessors(fail_block)) {
+            auto* branch = llvm::dyn_cast<llvm::BranchInst>(predecessor->getTerminator());
+            auto* compare = branch && branch->isConditional() ? llvm::dyn_cast<llvm::ICmpInst>(branch->getCondition())
+                                                              : nullptr;
+            if (!compare || branch->getSuccessor(0) == branch->getSuccessor(1)) {
+                continue;
+            }
+            // The predicate under which the branch skips the failure
+            bool fails_on_true = branch->getSuccessor(0) == fail_block;
+            llvm::ICmpInst::Predicate passes = fails_on_true ? compare->getInversePredicate() : compare->getPredicate();
+            if (!scev) {
+                scev = &analyses.getResult<llvm::ScalarEvolutionAnalysis>(function);
+                dominators = &analyses.getResult<llvm::DominatorTreeAnalysis>(function);
+            }
+            if (isKnownAt(*scev, *dominators, passes, compare->getOperand(0), compare->getOperand(1), branch)) {
+                // SimplifyCFG deletes the dead edge (and the failure block once unreachable)
+                branch->setCondition(llvm::ConstantInt::getBool(function.getContext(), !fails_on_true));
+                changed = true;
+            }
+        }
+    }
+    if (!changed) {
+        return llvm::PreservedAnalyses::all();
+    }
+    llvm::PreservedAnalyses preserved;
+    preserved.preserveSet<llvm::CFGAnalyses>();
+    return preserved;
+}
+
+llvm::PreservedAnalyses SpscChannelPass::run(llvm::Module& module, llvm::ModuleAnalysisManager&) {
+    // Claims of each global channel: sends, then receives
+    using Claims = llvm::SmallVector<llvm::AtomicCmpXchgInst*, 4>;
+    llvm::MapVector<llvm::GlobalVariable*, std::pair<Claims, Claims>> channels;
+    for (llvm::Function& function : module) {
+        for (llvm::Instruction& instruction : llvm::instructions(function)) {
+            auto* claim = llvm::dyn_cast<llvm::AtomicCmpXchgInst>(&instruction);
+            llvm::MDNode* side = claim ? claim->getMetadata(CHAN_CLAIM_METADATA) : nullptr;
+            if (!side) {
+                continue;
+            }
+            auto* chan = llvm::dyn_cast<llvm::GlobalVariable>(llvm::getUnderlyingObject(claim->getPointerOperand()));
+            if (chan) {
+                bool sending = llvm::cast<llvm::MDString>(side->getOperand(0))->getString() == "send";
+                (sending ? channels[chan].first : channels[chan].second).push_back(claim);
+            }
+        }
+    }
+
+    bool changed = false;
+    for (auto& [chan, claims] : channels) {
+        if (!isPrivateChannel(chan) || !isSingleThreaded(claims.first) || !isSingleThreaded(claims.second)) {
+            continue;
+        }
+        for (llvm::AtomicCmpXchgInst* claim : claims.first) {
+            claimWithStore(claim);
+        }
+        for (llvm::AtomicCmpXchgInst* claim : claims.second) {
+            claimWithStore(claim);
+        }
+        changed = true;
+    }
+    if (!changed) {
+        return llvm::PreservedAnalyses::all();
+    }
+    llvm::PreservedAnalyses preserved;
+    preserved.preserveSet<llvm::CFGAnalyses>();
+    return preserved;
+}
+
+} // namespace olang
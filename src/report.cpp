@@ -0,0 +1,342 @@
+#include "codegen.h"
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/Object/ObjectFile.h>
+#include <llvm/Object/ELFObjectFile.h>
+#include <llvm/Support/LEB128.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/FormatVariadic.h>
+#include <algorithm>
+#include <map>
+#include <numeric>
+
+namespace olang {
+
+namespace {
+
+struct FunctionSize {
+    std::string name;
+    uint64_t code_size = 0;
+    int64_t frame_size = -1;  // -1: no .stack_sizes entry
+    unsigned calls = 0;
+    uint64_t local_bytes = 0;
+    std::string largest_local;
+    uint64_t largest_local_size = 0;
+};
+
+// Decode .stack_sizes (function address + ULEB128 frame size per entry).
+// In a relocatable object the address is a relocation against either the
+// function symbol or, for internal functions, its section plus an offset.
+std::map<std::string, uint64_t> readStackSizes(const llvm::object::ObjectFile& obj) {
+    std::map<std::string, uint64_t> stack_sizes;
+
+    std::map<std::pair<uint64_t, uint64_t>, std::string> functions_by_location;
+    for (const llvm::object::SymbolRef& symbol : obj.symbols()) {
+        auto type = symbol.getType();
+        auto name = symbol.getName();
+        auto value = symbol.getValue();
+        auto section = symbol.getSection();
+        if (!type || !name || !value || !section || *type != llvm::object::SymbolRef::ST_Function ||
+            *section == obj.section_end()) {
+            if (!type) llvm::consumeError(type.takeError());
+            if (!name) llvm::consumeError(name.takeError());
+            if (!value) llvm::consumeError(value.takeError());
+            if (!section) llvm::consumeError(section.takeError());
+            continue;
+        }
+        functions_by_location[{(*section)->getIndex(), *value}] = name->str();
+    }
+
+    std::map<uint64_t, llvm::StringRef> stack_sections;
+    for (const llvm::object::SectionRef& section : obj.sections()) {
+        auto name = section.getName();
+        if (!name) {
+            llvm::consumeError(name.takeError());
+            continue;
+        }
+        if (*name != ".stack_sizes") {
+            continue;
+        }
+        auto contents = section.getContents();
+        if (!contents) {
+            llvm::consumeError(contents.takeError());
+            continue;
+        }
+        stack_sections[section.getIndex()] = *contents;
+    }
+
+    for (const llvm::object::SectionRef& reloc_section : obj.sections()) {
+        auto target = reloc_section.getRelocatedSection();
+        if (!target) {
+            llvm::consumeError(target.takeError());
+            continue;
+        }
+        if (*target == obj.section_end()) {
+            continue;
+        }
+        auto stack_section = stack_sections.find((*target)->getIndex());
+        if (stack_section == stack_sections.end()) {
+            continue;
+        }
+        llvm::StringRef contents = stack_section->second;
+
+        for (const llvm::object::RelocationRef& reloc : reloc_section.relocations()) {
+            uint64_t offset = reloc.getOffset();
+            auto symbol = reloc.getSymbol();
+            if (symbol == obj.symbol_end() || offset + 8 >= contents.size()) {
+                continue;
+            }
+
+            std::string function_name;
+            auto type = symbol->getType();
+            if (type && *type == llvm::object::SymbolRef::ST_Function) {
+                auto name = symbol->getName();
+                if (!name) {
+                    llvm::consumeError(name.takeError());
+                    continue;
+                }
+                function_name = name->str();
+            } else {
+                if (!type) llvm::consumeError(type.takeError());
+                auto section = symbol->getSection();
+                auto addend = llvm::object::ELFRelocationRef(reloc).getAddend();
+                if (!section || !addend || *section == obj.section_end()) {
+                    if (!section) llvm::consumeError(section.takeError());
+                    if (!addend) llvm::consumeError(addend.takeError());
+                    continue;
+                }
+                auto it = functions_by_location.find({(*section)->getIndex(), static_cast<uint64_t>(*addend)});
+                if (it == functions_by_location.end()) {
+                    continue;
+                }
+                function_name = it->second;
+            }
+
+            const uint8_t* begin = reinterpret_cast<const uint8_t*>(contents.data());
+            const uint8_t* end = begin + contents.size();
+            unsigned length = 0;
+            const char* error = nullptr;
+            uint64_t frame_size = llvm::decodeULEB128(begin + offset + 8, &length, end, &error);
+            if (!error) {
+                stack_sizes[function_name] = frame_size;
+            }
+        }
+    }
+
+    return stack_sizes;
+}
+
+constexpr uint64_t kCacheLineSize = 64;
+
+} // namespace
+
+std::string typeName(const Type& type) {
+    switch (type.kind) {
+        case TypeKind::I1: return "i1";
+        case TypeKind::I8: return "i8";
+        case TypeKind::I16: return "i16";
+        case TypeKind::I32: return "i32";
+        case TypeKind::I64: return "i64";
+        case TypeKind::F16: return "f16";
+        case TypeKind::F32: return "f32";
+        case TypeKind::F64: return "f64";
+        case TypeKind::POINTER: return "*" + typeName(*type.element_type);
+        case TypeKind::ARRAY:
+            return "array [" + std::to_string(type.array_size) + "] " + typeName(*type.element_type);
+        case TypeKind::STRUCT: return type.name;
+        case TypeKind::ATOMIC: return "atomic<" + typeName(*type.element_type) + ">";
+        case TypeKind::TASK: return "task<" + typeName(*type.element_type) + ">";
+        case TypeKind::CHAN:
+            return "chan<" + typeName(*type.element_type) + ", " + std::to_string(type.array_size) + ">";
+        case TypeKind::ARENA: return "arena";
+        case TypeKind::POOL: return "pool<" + typeName(*type.element_type) + ">";
+        case TypeKind::SLICE: return "slice " + typeName(*type.element_type);
+        case TypeKind::VOID: return "void";
+        default: return "?";
+    }
+}
+
+void CodeGenContext::printLayoutReport() {
+    const llvm::DataLayout& data_layout = module->getDataLayout();
+    
+    llvm::outs() << "olang layout report (" << module->getTargetTriple() << ", "
+                 << kCacheLineSize << "-byte cache lines)\n";
+    
+    for (const std::string& struct_name : struct_order) {
+        const StructInfo& info = struct_infos[struct_name];
+        if (!info.llvm_type || info.llvm_type->isOpaque()) {
+            continue;
+        }
+        const llvm::StructLayout* layout = data_layout.getStructLayout(info.llvm_type);
+        uint64_t size = static_cast<uint64_t>(data_layout.getTypeAllocSize(info.llvm_type));
+        uint64_t align = info.align.value();
+        
+        // Fields in memory order
+        struct FieldLayout {
+            uint64_t offset;
+            uint64_t size;
+            std::string description;
+        };
+        std::vector<FieldLayout> field_layouts;
+        uint64_t data_bytes = 0;
+        for (size_t i = 0; i < info.fields.size(); ++i) {
+            unsigned index = info.field_index[i];
+            llvm::Type* field_type = info.llvm_type->getElementType(index);
+            uint64_t field_size = static_cast<uint64_t>(data_layout.getTypeStoreSize(field_type));
+            field_layouts.push_back({
+                static_cast<uint64_t>(layout->getElementOffset(index)), field_size,
+                info.fields[i].second + ": " + typeName(info.fields[i].first)
+            });
+            data_bytes += field_size;
+        }
+        std::sort(field_layouts.begin(), field_layouts.end(),
+                  [](const FieldLayout& a, const FieldLayout& b) { return a.offset < b.offset; });
+        
+        uint64_t padding = size - data_bytes;
+        double waste = size ? static_cast<double>(padding) / static_cast<double>(size) : 0.0;
+        
+        llvm::outs() << "\nstruct " << info.name << " { size " << size << ", align " << align
+                     << ", padding " << padding << llvm::format(" (%.1f%%)", waste * 100.0) << " }\n";
+        
+        std::vector<std::string> warnings;
+        uint64_t cursor = 0;
+        uint64_t marked_line = 0;  // Last cache line with a marker (line 0 needs none)
+        for (const FieldLayout& field : field_layouts) {
+            if (field.offset > cursor) {
+                llvm::outs() << llvm::format("  %6llu %6llu  ", static_cast<unsigned long long>(cursor),
+                                             static_cast<unsigned long long>(field.offset - cursor))
+                             << "<hole>\n";
+            }
+            // Mark the first field starting in a new line, wherever in it the field starts
+            if (field.offset / kCacheLineSize > marked_line) {
+                marked_line = field.offset / kCacheLineSize;
+                llvm::outs() << "  --- cache line " << marked_line << " ---\n";
+            }
+            bool straddles = field.size > 0 &&
+                field.offset / kCacheLineSize != (field.offset + field.size - 1) / kCacheLineSize;
+            llvm::outs() << llvm::format("  %6llu %6llu  ", static_cast<unsigned long long>(field.offset),
+                                         static_cast<unsigned long long>(field.size))
+                         << field.description << (straddles ? "  <straddles cache line>" : "") << "\n";
+            if (straddles && field.size <= kCacheLineSize) {
+                warnings.push_back("field '" + field.description + "' straddles a cache line boundary");
+            }
+            cursor = std::max(cursor, field.offset + field.size);
+        }
+        if (size > cursor) {
+            llvm::outs() << llvm::format("  %6llu %6llu  ", static_cast<unsigned long long>(cursor),
+                                         static_cast<unsigned long long>(size - cursor))
+                         << "<tail padding>\n";
+        }
+        
+        // Consecutive elements of an array of this struct
+        if (size > 0 && size < kCacheLineSize && kCacheLineSize % size != 0) {
+            uint64_t period = kCacheLineSize / std::gcd(size, kCacheLineSize);
+            uint64_t straddling = 0;
+            for (uint64_t i = 0; i < period; ++i) {
+                uint64_t start = i * size;
+                if (start / kCacheLineSize != (start + size - 1) / kCacheLineSize) {
+                    straddling++;
+                }
+            }
+            warnings.push_back("in arrays, " + std::to_string(straddling) + " of every " +
+                               std::to_string(period) + " elements straddle a cache line");
+        } else if (size > kCacheLineSize) {
+            warnings.push_back("spans " + std::to_string((size + kCacheLineSize - 1) / kCacheLineSize) +
+                               " cache lines");
+        }
+        if (waste > layout_waste_threshold) {
+            warnings.push_back(llvm::formatv("{0:P} of the size is padding", waste).str());
+        }
+        
+        for (const std::string& warning : warnings) {
+            llvm::outs() << "  warning: " << warning << "\n";
+        }
+    }
+}
+
+void CodeGenContext::printSizeReport(llvm::StringRef object_data) {
+    auto obj = llvm::object::ObjectFile::createObjectFile(llvm::MemoryBufferRef(object_data, "olang"));
+    if (!obj) {
+        llvm::errs() << "Size report: " << llvm::toString(obj.takeError()) << "\n";
+        return;
+    }
+
+    // Machine code sizes from the symbol table
+    std::map<std::string, FunctionSize> functions;
+    for (const llvm::object::ELFSymbolRef symbol : (*obj)->symbols()) {
+        auto type = symbol.getType();
+        auto name = symbol.getName();
+        if (!type || !name || *type != llvm::object::SymbolRef::ST_Function) {
+            if (!type) llvm::consumeError(type.takeError());
+            if (!name) llvm::consumeError(name.takeError());
+            continue;
+        }
+        FunctionSize& info = functions[name->str()];
+        info.name = name->str();
+        info.code_size = symbol.getSize();
+    }
+
+    for (const auto& entry : readStackSizes(**obj)) {
+        auto it = functions.find(entry.first);
+        if (it != functions.end()) {
+            it->second.frame_size = static_cast<int64_t>(entry.second);
+        }
+    }
+
+    // Calls and locals from the IR
+    const llvm::DataLayout& data_layout = module->getDataLayout();
+    for (llvm::Function& function : *module) {
+        auto it = functions.find(function.getName().str());
+        if (function.isDeclaration() || it == functions.end()) {
+            continue;
+        }
+        FunctionSize& info = it->second;
+        for (llvm::BasicBlock& block : function) {
+            for (llvm::Instruction& inst : block) {
+                if (auto call = llvm::dyn_cast<llvm::CallBase>(&inst)) {
+                    if (!llvm::isa<llvm::IntrinsicInst>(call) && !call->isInlineAsm()) {
+                        info.calls++;
+                    }
+                } else if (auto alloca = llvm::dyn_cast<llvm::AllocaInst>(&inst)) {
+                    auto bits = alloca->getAllocationSizeInBits(data_layout);
+                    if (!bits || bits->isScalable()) {
+                        continue;
+                    }
+                    uint64_t bytes = bits->getFixedValue() / 8;
+                    info.local_bytes += bytes;
+                    if (bytes > info.largest_local_size) {
+                        info.largest_local_size = bytes;
+                        info.largest_local = alloca->getName().str();
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<FunctionSize> sorted;
+    for (auto& entry : functions) {
+        sorted.push_back(entry.second);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const FunctionSize& a, const FunctionSize& b) {
+        if (a.frame_size != b.frame_size) {
+            return a.frame_size > b.frame_size;
+        }
+        return a.code_size > b.code_size;
+    });
+
+    // Sorted by stack frame size, largest first
+    llvm::outs() << "olang size report (" << module->getTargetTriple() << ")\n";
+    llvm::outs() << "      code      frame    calls     locals  largest local            function\n";
+    for (const FunctionSize& info : sorted) {
+        std::string frame = info.frame_size < 0 ? "?" : std::to_string(info.frame_size);
+        std::string largest = info.largest_local.empty() ? "-" :
+            info.largest_local + " (" + std::to_string(info.largest_local_size) + ")";
+        llvm::outs() << llvm::format("%10llu %10s %8u %10llu  %-24s %s\n",
+                                     static_cast<unsigned long long>(info.code_size), frame.c_str(),
+                                     info.calls, static_cast<unsigned long long>(info.local_bytes),
+                                     largest.c_str(), info.name.c_str());
+    }
+}
+
+} // namespace olang
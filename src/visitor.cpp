@@ -2,9 +2,29 @@
 #include "OlangLexer.h"
 #include "OlangParser.h"
 #include <stdexcept>
+#include <climits>
 
 namespace olang {
 
+// Integer literal in a type (array length, channel capacity), checked against [min, max]
+static int parseTypeSize(const std::string& text, const std::string& what, uint64_t min, uint64_t max) {
+    uint64_t size = 0;
+    if (llvm::StringRef(text).getAsInteger(10, size) || size < min || size > max) {
+        throw std::runtime_error(what + " must be between " + std::to_string(min) + " and " + std::to_string(max) +
+                                 ": " + text);
+    }
+    return static_cast<int>(size);
+}
+
+// Element type of a pointer, array, atomic, channel, pool or slice type: task
+// handles are freed by the spawning function's sync, so nothing may hold one
+static std::shared_ptr<Type> elementType(const Type& type) {
+    if (type.kind == TypeKind::TASK) {
+        throw std::runtime_error("task<T> handles can only be held by local variables");
+    }
+    return std::make_shared<Type>(type);
+}
+
 std::any ASTVisitor::visitProgram(OlangParser::ProgramContext *ctx) {
     auto program = std::make_unique<Program>();
     
@@ -21,6 +41,9 @@ std::any ASTVisitor::visitProgram(OlangParser::ProgramContext *ctx) {
         } else if (auto extern_decl = dynamic_cast<OlangParser::Extern_declContext*>(decl)) {
             visitExtern_decl(extern_decl);
             program->declarations.push_back(popNode());
+        } else if (auto global_decl = dynamic_cast<OlangParser::Global_var_declContext*>(decl)) {
+            visitGlobal_var_decl(global_decl);
+            program->declarations.push_back(popNode());
         }
     }
     
@@ -31,11 +54,13 @@ std::any ASTVisitor::visitProgram(OlangParser::ProgramContext *ctx) {
 std::any ASTVisitor::visitStruct_decl(OlangParser::Struct_declContext *ctx) {
     auto struct_decl = std::make_unique<StructDecl>();
     struct_decl->name = ctx->IDENTIFIER()->getText();
+    struct_decl->attributes = parseAttributes(ctx->attribute());
     
     for (auto field : ctx->struct_field()) {
         Type field_type = parseType(field->type_spec());
         std::string field_name = field->IDENTIFIER()->getText();
         struct_decl->fields.emplace_back(field_type, field_name);
+        struct_decl->field_attributes.push_back(parseAttributes(field->attribute()));
     }
     
     pushNode(std::move(struct_decl));
@@ -46,6 +71,8 @@ std::any ASTVisitor::visitFunction_decl(OlangParser::Function_declContext *ctx)
     auto func_decl = std::make_unique<FunctionDecl>();
     func_decl->name = ctx->IDENTIFIER()->getText();
     func_decl->is_export = (ctx->EXPORT() != nullptr);
+    func_decl->is_bench = (ctx->BENCH() != nullptr);
+    func_decl->is_async = (ctx->ASYNC() != nullptr);
     
     // Parse parameters
     if (ctx->param_list()) {
@@ -75,6 +102,16 @@ std::any ASTVisitor::visitFunction_decl(OlangParser::Function_declContext *ctx)
             visitIf_statement(if_stmt);
         } else if (auto while_stmt = stmt->while_statement()) {
             visitWhile_statement(while_stmt);
+        } else if (auto for_stmt = stmt->for_statement()) {
+            visitFor_statement(for_stmt);
+        } else if (auto probe_stmt = stmt->probe_statement()) {
+            visitProbe_statement(probe_stmt);
+        } else if (auto parallel_for_stmt = stmt->parallel_for_statement()) {
+            visitParallel_for_statement(parallel_for_stmt);
+        } else if (auto sync_stmt = stmt->sync_statement()) {
+            visitSync_statement(sync_stmt);
+        } else if (auto arena_stmt = stmt->arena_statement()) {
+            visitArena_statement(arena_stmt);
         }
         func_decl->body.push_back(popNode());
     }
@@ -86,6 +123,7 @@ std::any ASTVisitor::visitFunction_decl(OlangParser::Function_declContext *ctx)
 std::any ASTVisitor::visitExtern_decl(OlangParser::Extern_declContext *ctx) {
     auto extern_decl = std::make_unique<ExternDecl>();
     extern_decl->name = ctx->IDENTIFIER()->getText();
+    extern_decl->is_async = (ctx->ASYNC() != nullptr);
     
     // Parse parameters
     if (ctx->param_list()) {
@@ -107,10 +145,25 @@ std::any ASTVisitor::visitExtern_decl(OlangParser::Extern_declContext *ctx) {
     return nullptr;
 }
 
+std::any ASTVisitor::visitGlobal_var_decl(OlangParser::Global_var_declContext *ctx) {
+    auto global_decl = std::make_unique<GlobalVarDecl>();
+    global_decl->type = parseType(ctx->type_spec());
+    global_decl->name = ctx->IDENTIFIER()->getText();
+    global_decl->attributes = parseAttributes(ctx->attribute());
+    global_decl->is_thread_local = (ctx->THREAD_LOCAL() != nullptr);
+    
+    visit(ctx->expression());
+    global_decl->value = popNode();
+    
+    pushNode(std::move(global_decl));
+    return nullptr;
+}
+
 std::any ASTVisitor::visitLet_statement(OlangParser::Let_statementContext *ctx) {
     auto let_stmt = std::make_unique<LetStmt>();
     let_stmt->type = parseType(ctx->type_spec());
     let_stmt->name = ctx->IDENTIFIER()->getText();
+    let_stmt->attributes = parseAttributes(ctx->attribute());
     
     visit(ctx->expression());
     let_stmt->value = popNode();
@@ -209,6 +262,118 @@ std::any ASTVisitor::visitWhile_statement(OlangParser::While_statementContext *c
     return nullptr;
 }
 
+std::any ASTVisitor::visitFor_statement(OlangParser::For_statementContext *ctx) {
+    auto for_stmt = std::make_unique<ForStmt>();
+    for_stmt->var = ctx->IDENTIFIER()->getText();
+    
+    visit(ctx->expression(0));
+    for_stmt->iterable = popNode();
+    if (ctx->DOTDOT()) {
+        visit(ctx->expression(1));
+        for_stmt->end = popNode();
+    }
+    if (ctx->STEP()) {
+        visit(ctx->expression(2));
+        for_stmt->step = popNode();
+    }
+    
+    for (auto stmt : ctx->statement()) {
+        visit(stmt);
+        for_stmt->body.push_back(popNode());
+    }
+    
+    pushNode(std::move(for_stmt));
+    return nullptr;
+}
+
+std::any ASTVisitor::visitParallel_for_statement(OlangParser::Parallel_for_statementContext *ctx) {
+    auto for_stmt = std::make_unique<ParallelForStmt>();
+    for_stmt->var = ctx->IDENTIFIER()->getText();
+    
+    if (auto reduce = ctx->reduce_clause()) {
+        for_stmt->reduce_var = reduce->IDENTIFIER()->getText();
+        auto op = reduce->reduce_op();
+        std::string name = op->getText();
+        if (op->PLUS()) {
+            for_stmt->reduce_op = ParallelForStmt::ADD;
+        } else if (op->MULTIPLY()) {
+            for_stmt->reduce_op = ParallelForStmt::MUL;
+        } else if (name == "min") {
+            for_stmt->reduce_op = ParallelForStmt::MIN;
+        } else if (name == "max") {
+            for_stmt->reduce_op = ParallelForStmt::MAX;
+        } else {
+            for_stmt->reduce_op = ParallelForStmt::CUSTOM;
+            for_stmt->reduce_function = name;
+        }
+        if (reduce->expression()) {
+            visit(reduce->expression());
+            for_stmt->reduce_identity = popNode();
+        }
+    }
+    
+    visit(ctx->expression(0));
+    for_stmt->start = popNode();
+    visit(ctx->expression(1));
+    for_stmt->end = popNode();
+    
+    if (auto schedule = ctx->schedule_clause()) {
+        std::string kind = schedule->IDENTIFIER()->getText();
+        if (kind == "dynamic") {
+            for_stmt->schedule = ParallelForStmt::DYNAMIC;
+        } else if (kind != "static") {
+            throw std::runtime_error("Unknown schedule kind: " + kind);
+        }
+        if (schedule->expression()) {
+            visit(schedule->expression());
+            for_stmt->chunk = popNode();
+        }
+    }
+    
+    for (auto stmt : ctx->statement()) {
+        visit(stmt);
+        for_stmt->body.push_back(popNode());
+    }
+    
+    pushNode(std::move(for_stmt));
+    return nullptr;
+}
+
+std::any ASTVisitor::visitSync_statement(OlangParser::Sync_statementContext *ctx) {
+    pushNode(std::make_unique<SyncStmt>());
+    return nullptr;
+}
+
+std::any ASTVisitor::visitArena_statement(OlangParser::Arena_statementContext *ctx) {
+    auto arena_stmt = std::make_unique<ArenaStmt>();
+    arena_stmt->name = ctx->IDENTIFIER()->getText();
+    
+    for (auto stmt : ctx->statement()) {
+        visit(stmt);
+        arena_stmt->body.push_back(popNode());
+    }
+    
+    pushNode(std::move(arena_stmt));
+    return nullptr;
+}
+
+std::any ASTVisitor::visitProbe_statement(OlangParser::Probe_statementContext *ctx) {
+    auto probe_stmt = std::make_unique<ProbeStmt>();
+    probe_stmt->provider = ctx->IDENTIFIER(0)->getText();
+    probe_stmt->name = ctx->IDENTIFIER(1)->getText();
+    
+    if (ctx->argument_list()) {
+        for (auto expr_ctx : ctx->argument_list()->expression()) {
+            visit(expr_ctx);
+            auto arg = popNode();
+            probe_stmt->args.push_back(std::unique_ptr<Expr>(static_cast<Expr*>(arg.release())));
+        }
+    }
+    
+    pushNode(std::move(probe_stmt));
+    return nullptr;
+}
+
 std::any ASTVisitor::visitAssignment_expr(OlangParser::Assignment_exprContext *ctx) {
     if (ctx->ASSIGN()) {
         // Assignment expression
@@ -405,6 +570,11 @@ std::any ASTVisitor::visitUnary_expr(OlangParser::Unary_exprContext *ctx) {
             std::unique_ptr<Expr>(static_cast<Expr*>(operand.release()))
         );
         pushNode(std::move(unary_expr));
+    } else if (ctx->AWAIT()) {
+        visit(ctx->unary_expr());
+        auto await_expr = std::make_unique<AwaitExpr>();
+        await_expr->call = std::unique_ptr<Expr>(static_cast<Expr*>(popNode().release()));
+        pushNode(std::move(await_expr));
     } else {
         visit(ctx->postfix_expr());
     }
@@ -513,6 +683,25 @@ std::any ASTVisitor::visitPrimary_expr(OlangParser::Primary_exprContext *ctx) {
     } else if (ctx->LPAREN()) {
         visit(ctx->expression());
         // Parenthesized expression, no extra handling needed
+    } else if (auto spawn = ctx->spawn_expr()) {
+        auto spawn_expr = std::make_unique<SpawnExpr>();
+        spawn_expr->function_name = spawn->IDENTIFIER()->getText();
+        if (spawn->argument_list()) {
+            for (auto expr_ctx : spawn->argument_list()->expression()) {
+                visit(expr_ctx);
+                auto arg = popNode();
+                spawn_expr->args.push_back(std::unique_ptr<Expr>(static_cast<Expr*>(arg.release())));
+            }
+        }
+        pushNode(std::move(spawn_expr));
+    } else if (auto alloc = ctx->alloc_expr()) {
+        auto alloc_expr = std::make_unique<AllocExpr>();
+        alloc_expr->type = parseType(alloc->type_spec());
+        visit(alloc->expression(0));
+        alloc_expr->arena = std::unique_ptr<Expr>(static_cast<Expr*>(popNode().release()));
+        visit(alloc->expression(1));
+        alloc_expr->count = std::unique_ptr<Expr>(static_cast<Expr*>(popNode().release()));
+        pushNode(std::move(alloc_expr));
     }
     
     return nullptr;
@@ -530,12 +719,42 @@ Type ASTVisitor::parseType(OlangParser::Type_specContext *ctx) {
         else if (basic->F32()) return Type(TypeKind::F32);
         else if (basic->F64()) return Type(TypeKind::F64);
     } else if (ctx->pointer_type()) {
-        auto element_type = std::make_shared<Type>(parseType(ctx->pointer_type()->type_spec()));
+        auto element_type = elementType(parseType(ctx->pointer_type()->type_spec()));
         return Type(TypeKind::POINTER, element_type);
     } else if (ctx->array_type()) {
-        int size = std::stoi(ctx->array_type()->INT_LITERAL()->getText());
-        auto element_type = std::make_shared<Type>(parseType(ctx->array_type()->type_spec()));
+        int size = parseTypeSize(ctx->array_type()->INT_LITERAL()->getText(), "array length", 0, INT_MAX);
+        auto element_type = elementType(parseType(ctx->array_type()->type_spec()));
         return Type(TypeKind::ARRAY, size, element_type);
+    } else if (ctx->atomic_type()) {
+        auto element_type = elementType(parseType(ctx->atomic_type()->type_spec()));
+        // LLVM atomics need a pointer or an integer of at least a byte (no i1)
+        TypeKind kind = element_type->kind;
+        if (kind != TypeKind::I8 && kind != TypeKind::I16 && kind != TypeKind::I32 && kind != TypeKind::I64 &&
+            kind != TypeKind::POINTER) {
+            throw std::runtime_error("atomic<T> needs an i8, i16, i32, i64 or pointer T");
+        }
+        return Type(TypeKind::ATOMIC, element_type);
+    } else if (ctx->task_type()) {
+        auto result_type = std::make_shared<Type>(ctx->task_type()->type_spec() ?
+            parseType(ctx->task_type()->type_spec()) : Type(TypeKind::VOID));
+        return Type(TypeKind::TASK, result_type);
+    } else if (ctx->chan_type()) {
+        // Rounded up to a power of two, so at most 2^30
+        int requested = parseTypeSize(ctx->chan_type()->INT_LITERAL()->getText(), "channel capacity", 1, 1 << 30);
+        int capacity = 2;
+        while (capacity < requested) {
+            capacity *= 2;
+        }
+        auto element_type = elementType(parseType(ctx->chan_type()->type_spec()));
+        return Type(TypeKind::CHAN, capacity, element_type);
+    } else if (ctx->arena_type()) {
+        return Type(TypeKind::ARENA);
+    } else if (ctx->pool_type()) {
+        auto element_type = elementType(parseType(ctx->pool_type()->type_spec()));
+        return Type(TypeKind::POOL, element_type);
+    } else if (ctx->slice_type()) {
+        auto element_type = elementType(parseType(ctx->slice_type()->type_spec()));
+        return Type(TypeKind::SLICE, element_type);
     } else if (ctx->struct_type()) {
         return Type(TypeKind::STRUCT, ctx->struct_type()->IDENTIFIER()->getText());
     }
@@ -543,6 +762,19 @@ Type ASTVisitor::parseType(OlangParser::Type_specContext *ctx) {
     return Type(TypeKind::VOID);
 }
 
+std::vector<Attribute> ASTVisitor::parseAttributes(const std::vector<OlangParser::AttributeContext*>& attributes) {
+    std::vector<Attribute> result;
+    for (auto attribute_ctx : attributes) {
+        Attribute attribute;
+        attribute.name = attribute_ctx->IDENTIFIER()->getText();
+        for (auto arg : attribute_ctx->attribute_arg()) {
+            attribute.args.push_back(arg->getText());
+        }
+        result.push_back(std::move(attribute));
+    }
+    return result;
+}
+
 BinaryExpr::Op ASTVisitor::getBinaryOp(antlr4::Token* token) {
     switch (token->getType()) {
         case OlangParser::PLUS: return BinaryExpr::ADD;
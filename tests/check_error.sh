@@ -0,0 +1,24 @@
+#!/bin/bash
+# Usage: check_error.sh <olc> <FileCheck> <test.olang> <work dir>
+#
+# Compiles a tests/errors test, with the flags on its "// OLC:" line, expects
+# olc to fail, and checks its diagnostics against the test's CHECK lines
+
+OLC="$1"
+FILECHECK="$2"
+TEST="$3"
+WORK_DIR="$4"
+
+mkdir -p "$WORK_DIR"
+OUTPUT="$WORK_DIR/$(basename "$TEST" .olang)"
+FLAGS=$(sed -n 's|^// OLC:||p' "$TEST")
+
+if "$OLC" "$TEST" -o "$OUTPUT.o" $FLAGS > "$OUTPUT.log" 2>&1; then
+    echo "olc accepted $TEST"
+    exit 1
+fi
+if [[ -e "$OUTPUT.o" ]]; then
+    echo "olc wrote output for $TEST"
+    exit 1
+fi
+"$FILECHECK" --input-file="$OUTPUT.log" "$TEST"
@@ -0,0 +1,19 @@
+#!/bin/bash
+# Usage: check_ir.sh <olc> <FileCheck> <test.olang> <work dir>
+#
+# Compiles a tests/codegen test to LLVM IR, after the -O pipeline, with the
+# flags on its "// OLC:" line, and checks the IR against its CHECK lines
+
+set -e
+
+OLC="$1"
+FILECHECK="$2"
+TEST="$3"
+WORK_DIR="$4"
+
+mkdir -p "$WORK_DIR"
+OUTPUT="$WORK_DIR/$(basename "$TEST" .olang).ll"
+FLAGS=$(sed -n 's|^// OLC:||p' "$TEST")
+
+"$OLC" "$TEST" --emit-llvm -o "$OUTPUT" $FLAGS > /dev/null
+"$FILECHECK" --input-file="$OUTPUT" "$TEST"
@@ -0,0 +1,19 @@
+#!/bin/bash
+# Usage: check_output.sh <olc> <FileCheck> <test.olang> <work dir>
+#
+# Compiles a tests/reports test to an object file with the flags on its
+# "// OLC:" line and checks what olc prints against the test's CHECK lines
+
+set -e
+
+OLC="$1"
+FILECHECK="$2"
+TEST="$3"
+WORK_DIR="$4"
+
+mkdir -p "$WORK_DIR"
+OUTPUT="$WORK_DIR/$(basename "$TEST" .olang)"
+FLAGS=$(sed -n 's|^// OLC:||p' "$TEST")
+
+"$OLC" "$TEST" -o "$OUTPUT.o" $FLAGS > "$OUTPUT.log" 2>&1
+"$FILECHECK" --input-file="$OUTPUT.log" "$TEST"
@@ -0,0 +1,21 @@
+#!/bin/bash
+# Usage: run_example.sh <olc> <libolang_rt.a> <name> <work dir>
+#
+# Builds examples/src/<name>.olang the way examples/scripts/build_all.sh does,
+# runs it, and expects it to exit 0 after printing "<name>: ok"
+
+set -e
+
+OLC="$1"
+OLANG_RT="$2"
+NAME="$3"
+WORK_DIR="$4"
+PROJECT_DIR="$(dirname "$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)")"
+
+mkdir -p "$WORK_DIR"
+"$OLC" "$PROJECT_DIR/examples/src/$NAME.olang" -O2 -o "$WORK_DIR/$NAME.o" > /dev/null
+OLANG_RT="$OLANG_RT" "$PROJECT_DIR/olang-link" "$WORK_DIR/$NAME" "$WORK_DIR/$NAME.o" -lc > /dev/null
+
+OUTPUT=$("$WORK_DIR/$NAME")
+echo "$OUTPUT"
+grep -qx "$NAME: ok" <<< "$OUTPUT"